@@ -0,0 +1,44 @@
+#include "include/arena.hpp"
+
+#include <cstring>
+
+RssArena::RssArena(size_t t_blockSize) : blockSize(t_blockSize)
+{
+
+}
+
+char* RssArena::allocate(size_t size)
+{
+    totalUsed += size;
+    if(size > blockSize / 4) //Give big strings their own block so the block being filled isn't wasted
+    {
+        std::unique_ptr<char[]> big(new char[size]);
+        char* mem = big.get();
+        blocks.insert( (blocks.empty()) ? blocks.end() : blocks.end() - 1, std::move(big)); //Keep the block being filled last
+        return mem;
+    }
+
+    if(blocks.empty() || blockCapacity - blockUsed < size) //Start a new block when this one is full
+    {
+        blocks.emplace_back(new char[blockSize]);
+        blockCapacity = blockSize;
+        blockUsed = 0;
+    }
+
+    char* mem = blocks.back().get() + blockUsed;
+    blockUsed += size;
+    return mem;
+}
+
+std::string_view RssArena::store(const char* str, size_t size)
+{
+    char* mem = allocate(size + 1);
+    if(size > 0) memcpy(mem, str, size); //Empty views can have a NULL data pointer
+    mem[size] = '\0'; //Views from the arena can always be used as C strings
+    return std::string_view(mem, size);
+}
+
+void RssArena::keepAlive(std::shared_ptr<const void> owner)
+{
+    owners.push_back(std::move(owner));
+}
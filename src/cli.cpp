@@ -0,0 +1,291 @@
+#include "include/rss.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+/**
+ * @brief The old cleanHTML that erased one tag at a time, kept to benchmark 
+ * against the single pass version. Stops at a '<' with no closing '>' instead
+ * of looping forever like the original did
+ * 
+ * @param str The string reference to remove tags from
+ */
+static void legacyCleanHTML(std::string& str)
+{
+    while (str.find("<") != std::string::npos)
+    {
+        auto startpos = str.find("<");
+        auto endpos = str.find(">", startpos);
+        if (endpos == std::string::npos) break;
+
+        str.erase(startpos, endpos + 1 - startpos);
+    }
+}
+
+/**
+ * @brief Function to get the number of milliseconds since a time point
+ * 
+ * @param start The time point to measure from
+ * @return double Milliseconds since start
+ */
+static double msSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Function to print how to use the CLI
+ * 
+ */
+static void printUsage(void)
+{
+    printf("Usage: goodnews-cli <command> [arguments]\n"
+           "Commands:\n"
+           "  refresh                  Load every feed in subscribed.txt, downloading feeds whose ttl passed\n"
+           "  add <url>                Subscribe to the feed at a URL\n"
+           "  dump [title]             Print every channel, or only the channel with a title, and its items\n"
+           "  watch <minutes>          Keep refreshing feeds as they become due for a number of minutes\n"
+           "  bench [-n runs] <file>...  Time parsing RSS, Atom, and RDF files with pugixml and streaming, and cleaning their item descriptions\n");
+}
+
+/**
+ * @brief Command to load every subscribed channel and print how long it took
+ * 
+ * @return int The exit code
+ */
+static int refreshCommand(void)
+{
+    RssFeedManager manager;
+    auto start = std::chrono::steady_clock::now();
+    manager.loadChannelsFromRecord();
+    double elapsed = msSince(start);
+
+    std::shared_ptr<const RssChannelList> channels = manager.snapshot();
+    size_t wireBytes = 0, decodedBytes = 0; //Feed bytes before and after decompressing them
+    for(const auto& ch : *channels)
+    {
+        if(ch->decodedBytes == 0) 
+        {
+            printf("%-50s %5zu items    not downloaded\n", ch->title.c_str(), ch->items.size());
+            continue;
+        }
+        wireBytes += ch->wireBytes;
+        decodedBytes += ch->decodedBytes;
+        printf("%-50s %5zu items %8zu KiB downloaded %8zu KiB XML\n", ch->title.c_str(), ch->items.size(), ch->wireBytes / 1024, ch->decodedBytes / 1024);
+    }
+    printf("Loaded %zu channels in %.1f ms, downloaded %zu KiB for %zu KiB of XML\n", channels->size(), elapsed, wireBytes / 1024, decodedBytes / 1024);
+    return 0;
+}
+
+/**
+ * @brief Command to subscribe to a new feed
+ * 
+ * @param url The URL of the RSS feed
+ * @return int The exit code
+ */
+static int addCommand(const std::string& url)
+{
+    RssFeedManager manager;
+    manager.loadChannelsFromRecord(); //Load the existing channels first so they stay in the record
+    try
+    {
+        manager.addChannel(url);
+    }
+    catch(const std::exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    printf("Subscribed to %s\n", url.c_str());
+    return 0;
+}
+
+/**
+ * @brief Command to print channels and all of their items
+ * 
+ * @param title The title of the only channel to print, or empty to print all channels
+ * @return int The exit code
+ */
+static int dumpCommand(const std::string& title)
+{
+    RssFeedManager manager;
+    manager.loadChannelsFromRecord();
+
+    for(const auto& ch : *manager.snapshot())
+    {
+        if(!title.empty() && ch->title != title) continue;
+
+        printf("== %s ==\nLink: %s\nDescription: %s\n\n", ch->title.c_str(), ch->link.c_str(), ch->description.c_str());
+        for(const RssItem& item : ch->items)
+        {
+            printf("Title: %s\nLink: %s\n", item.title.data(), item.link.data());
+            if(!item.pubDate.empty()) printf("Published: %s\n", item.pubDate.data());
+            if(!item.author.empty()) printf("Author: %s\n", item.author.data());
+            if(!item.enclosure.url.empty()) printf("Image: %s\n", item.enclosure.url.data());
+            printf("Description: %s\n\n", item.description.data());
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Command to run the background refresh thread for a while, printing
+ * every channel list that it publishes
+ * 
+ * @param minutes How long to keep refreshing for
+ * @return int The exit code
+ */
+static int watchCommand(size_t minutes)
+{
+    RssFeedManager manager;
+    manager.loadChannelsFromRecord();
+
+    manager.onPublish = [&manager](void)
+    {
+        size_t items = 0;
+        std::shared_ptr<const RssChannelList> channels = manager.snapshot();
+        for(const auto& ch : *channels) items += ch->items.size();
+        printf("Published %zu channels with %zu items\n", channels->size(), items);
+        fflush(stdout);
+    };
+    manager.startRefreshing();
+
+    std::this_thread::sleep_for(std::chrono::minutes(minutes));
+    return 0; //The manager stops refreshing and writes the record when it is destroyed
+}
+
+/**
+ * @brief Command to time parsing RSS files and cleaning the HTML out of their
+ * item descriptions with the new and old cleanHTML
+ * 
+ * @param files The RSS files to parse
+ * @param runs How many times to parse every file
+ * @return int The exit code
+ */
+static int benchCommand(const std::vector<std::string>& files, size_t runs)
+{
+    std::vector<std::string> descriptions; //Raw item descriptions from every file to clean
+    size_t descriptionBytes = 0;
+
+    for(const std::string& path : files)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if(data.empty())
+        {
+            fprintf(stderr, "Failed to read %s\n", path.c_str());
+            return 1;
+        }
+
+        size_t items = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(size_t run = 0; run < runs; ++run)
+        {
+            pugi::xml_document doc;
+            if(!doc.load_buffer(data.data(), data.size()))
+            {
+                fprintf(stderr, "Failed to parse %s\n", path.c_str());
+                return 1;
+            }
+            try
+            {
+                items = RssChannel::fromXML(doc, path).items.size();
+            }
+            catch(const std::exception& e)
+            {
+                fprintf(stderr, "Failed to read channel from %s: %s\n", path.c_str(), e.what());
+                return 1;
+            }
+
+            if(run == 0) //Keep the raw descriptions for the cleanHTML benchmark
+            {
+                for(const pugi::xpath_node& desc : doc.select_nodes("//item/description | //entry/summary | //entry/content"))
+                {
+                    descriptions.push_back(desc.node().text().as_string());
+                    descriptionBytes += descriptions.back().size();
+                }
+            }
+        }
+        double elapsed = msSince(start);
+        printf("%-40s %6zu KiB %5zu items %9.3f ms/parse %8.1f MiB/s\n", path.c_str(), data.size() / 1024, items, elapsed / runs, (data.size() * runs) / (1024.0 * 1024.0) / (elapsed / 1000.0));
+
+        //Parse the same file in pieces the way a download arrives, without building a DOM
+        const size_t pieceSize = 16 * 1024;
+        start = std::chrono::steady_clock::now();
+        for(size_t run = 0; run < runs; ++run)
+        {
+            RssStreamParser parser(path);
+            bool parsed = true;
+            for(size_t pos = 0; parsed && pos < data.size(); pos += pieceSize)
+            {
+                parsed = parser.feed(data.data() + pos, std::min(pieceSize, data.size() - pos));
+            }
+            if(!parsed)
+            {
+                fprintf(stderr, "Failed to stream %s: %s\n", path.c_str(), parser.error().c_str());
+                return 1;
+            }
+            try
+            {
+                items = parser.finish().items.size();
+            }
+            catch(const std::exception& e)
+            {
+                fprintf(stderr, "Failed to read streamed channel from %s: %s\n", path.c_str(), e.what());
+                return 1;
+            }
+        }
+        elapsed = msSince(start);
+        printf("%-40s %6zu KiB %5zu items %9.3f ms/parse %8.1f MiB/s\n", "  streamed in 16 KiB pieces", data.size() / 1024, items, elapsed / runs, (data.size() * runs) / (1024.0 * 1024.0) / (elapsed / 1000.0));
+    }
+
+    //Clean copies of the descriptions so every run starts from the same HTML
+    auto benchClean = [&](void (*clean)(std::string&)) -> double
+    {
+        auto start = std::chrono::steady_clock::now();
+        for(size_t run = 0; run < runs; ++run)
+        {
+            for(const std::string& desc : descriptions)
+            {
+                std::string copy = desc;
+                clean(copy);
+            }
+        }
+        return msSince(start) / runs;
+    };
+
+    double newMs = benchClean(cleanHTML);
+    double oldMs = benchClean(legacyCleanHTML);
+    printf("cleanHTML on %zu descriptions (%zu KiB): %.3f ms single pass, %.3f ms erase loop, %.1fx\n", descriptions.size(), descriptionBytes / 1024, newMs, oldMs, (newMs > 0.0) ? oldMs / newMs : 0.0);
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::string command = argv[1];
+    if(command == "refresh") return refreshCommand();
+    if(command == "add" && argc == 3) return addCommand(argv[2]);
+    if(command == "dump") return dumpCommand( (argc > 2) ? argv[2] : "");
+    if(command == "watch" && argc == 3) return watchCommand(std::strtoull(argv[2], NULL, 10));
+    if(command == "bench")
+    {
+        size_t runs = 10; //How many times to parse every file
+        std::vector<std::string> files;
+        for(int i = 2; i < argc; ++i)
+        {
+            if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) runs = std::max<size_t>(std::strtoull(argv[++i], NULL, 10), 1);
+            else files.push_back(argv[i]);
+        }
+        if(!files.empty()) return benchCommand(files, runs);
+    }
+
+    printUsage();
+    return 1;
+}
@@ -0,0 +1,242 @@
+#include "include/date.hpp"
+
+#include <cctype>
+#include <string>
+
+/**
+ * @brief Function to get the number of days from 1970-01-01 to a date in the Gregorian calendar
+ *
+ * @param year The year
+ * @param month The month, 1 to 12
+ * @param day The day of the month, 1 to 31
+ * @return int64_t The number of days, negative before 1970
+ */
+static int64_t daysFromCivil(int64_t year, int month, int day)
+{
+    year -= (month <= 2); //Count years from March so the leap day is the last day of the year
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468; //719468 days from 0000-03-01 to 1970-01-01
+}
+
+/**
+ * @brief Function to read a number with a limited number of digits
+ *
+ * @param p The position to read from, moved past the digits
+ * @param end The end of the text
+ * @param minDigits The fewest digits the number can have
+ * @param maxDigits The most digits to read
+ * @param out The number
+ * @return true if there were at least minDigits digits
+ */
+static bool readNumber(const char*& p, const char* end, int minDigits, int maxDigits, int& out)
+{
+    int digits = 0;
+    out = 0;
+    while(p < end && digits < maxDigits && std::isdigit((unsigned char)*p))
+    {
+        out = out * 10 + (*p - '0');
+        ++p;
+        ++digits;
+    }
+    return digits >= minDigits;
+}
+
+static void skipSpaces(const char*& p, const char* end)
+{
+    while(p < end && std::isspace((unsigned char)*p)) ++p;
+}
+
+/**
+ * @brief Function to read a numeric time zone like +0100, -05:00, or +01
+ *
+ * @param p The position of the sign, moved past the zone
+ * @param end The end of the text
+ * @param offset The offset from UTC in seconds
+ * @return true if the zone was read
+ */
+static bool readNumericZone(const char*& p, const char* end, int& offset)
+{
+    int sign = (*p == '-') ? -1 : 1;
+    ++p;
+
+    int hours, minutes = 0;
+    if(!readNumber(p, end, 2, 2, hours)) return false;
+    if(p < end && *p == ':') ++p;
+    if(p < end && std::isdigit((unsigned char)*p) && !readNumber(p, end, 2, 2, minutes)) return false;
+    if(hours > 23 || minutes > 59) return false;
+
+    offset = sign * (hours * 3600 + minutes * 60);
+    return true;
+}
+
+/**
+ * @brief Function to read the time zone at the end of an RFC 822 date
+ *
+ * @param p The position of the zone, moved past it
+ * @param end The end of the text
+ * @param offset The offset from UTC in seconds
+ * @return true if the zone was read, a missing zone is UTC
+ */
+static bool readRfc822Zone(const char*& p, const char* end, int& offset)
+{
+    offset = 0;
+    skipSpaces(p, end);
+    if(p == end) return true; //Many feeds leave the zone out, so guess UTC
+    if(*p == '+' || *p == '-') return readNumericZone(p, end, offset);
+
+    //The named zones from RFC 822, single letter military zones are too often wrong to trust so they are read as UTC
+    static const struct { const char* name; int hours; } ZONES[] = {
+        {"GMT", 0}, {"UTC", 0}, {"UT", 0}, {"Z", 0},
+        {"EST", -5}, {"EDT", -4}, {"CST", -6}, {"CDT", -5}, {"MST", -7}, {"MDT", -6}, {"PST", -8}, {"PDT", -7}
+    };
+    const char* nameStart = p;
+    while(p < end && std::isalpha((unsigned char)*p)) ++p;
+    std::string_view name(nameStart, (size_t)(p - nameStart));
+    if(name.size() == 1) return true;
+
+    for(const auto& zone : ZONES)
+    {
+        if(name.size() != std::char_traits<char>::length(zone.name)) continue;
+        bool same = true;
+        for(size_t i = 0; i < name.size() && same; ++i) same = (std::toupper((unsigned char)name[i]) == zone.name[i]);
+        if(same)
+        {
+            offset = zone.hours * 3600;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Function to read the month name of an RFC 822 date
+ *
+ * @param p The position of the name, moved past it
+ * @param end The end of the text
+ * @return int The month, 1 to 12, or 0 if it isn't a month
+ */
+static int readMonthName(const char*& p, const char* end)
+{
+    static const char* MONTHS = "janfebmaraprmayjunjulaugsepoctnovdec";
+    if(end - p < 3) return 0;
+
+    char name[3] = { (char)std::tolower((unsigned char)p[0]), (char)std::tolower((unsigned char)p[1]), (char)std::tolower((unsigned char)p[2]) };
+    for(int m = 0; m < 12; ++m)
+    {
+        if(MONTHS[m * 3] == name[0] && MONTHS[m * 3 + 1] == name[1] && MONTHS[m * 3 + 2] == name[2])
+        {
+            p += 3;
+            while(p < end && std::isalpha((unsigned char)*p)) ++p; //Skip the rest of a long month name like "June"
+            return m + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Function to check the fields of a date and turn it into seconds since the epoch
+ *
+ * @return int64_t The seconds since 1970-01-01 in UTC, or 0 if a field is out of range
+ */
+static int64_t toEpoch(int year, int month, int day, int hour, int minute, int second, int offset)
+{
+    if(month < 1 || month > 12 || day < 1 || day > 31 || hour > 24 || minute > 59 || second > 60) return 0;
+    return daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second - offset;
+}
+
+/**
+ * @brief Function to read an RFC 3339 date like 2003-12-13T18:30:02.25+01:00, or only the day like 2003-12-13
+ *
+ * @param p The start of the text
+ * @param end The end of the text
+ * @return int64_t The seconds since 1970-01-01 in UTC, or 0 if it isn't a date
+ */
+static int64_t parseRfc3339(const char* p, const char* end)
+{
+    int year, month, day, hour = 0, minute = 0, second = 0, offset = 0;
+    if(!readNumber(p, end, 4, 4, year) || p == end || *p++ != '-') return 0;
+    if(!readNumber(p, end, 2, 2, month) || p == end || *p++ != '-') return 0;
+    if(!readNumber(p, end, 2, 2, day)) return 0;
+
+    if(p < end && (*p == 'T' || *p == 't' || *p == ' '))
+    {
+        ++p;
+        if(!readNumber(p, end, 2, 2, hour) || p == end || *p++ != ':') return 0;
+        if(!readNumber(p, end, 2, 2, minute)) return 0;
+        if(p < end && *p == ':')
+        {
+            ++p;
+            if(!readNumber(p, end, 2, 2, second)) return 0;
+            if(p < end && (*p == '.' || *p == ',')) //Fractions of a second don't matter for ordering items
+            {
+                ++p;
+                while(p < end && std::isdigit((unsigned char)*p)) ++p;
+            }
+        }
+
+        if(p < end && (*p == 'Z' || *p == 'z')) ++p;
+        else if(p < end && (*p == '+' || *p == '-') && !readNumericZone(p, end, offset)) return 0;
+    }
+
+    skipSpaces(p, end);
+    if(p != end) return 0;
+    return toEpoch(year, month, day, hour, minute, second, offset);
+}
+
+/**
+ * @brief Function to read an RFC 822 date like "Tue, 10 Jun 2003 04:00:00 GMT", where
+ * the day name and seconds are optional and the year can have two digits
+ *
+ * @param p The start of the text
+ * @param end The end of the text
+ * @return int64_t The seconds since 1970-01-01 in UTC, or 0 if it isn't a date
+ */
+static int64_t parseRfc822(const char* p, const char* end)
+{
+    if(p < end && std::isalpha((unsigned char)*p)) //Skip the day name, it doesn't add anything
+    {
+        while(p < end && std::isalpha((unsigned char)*p)) ++p;
+        if(p < end && *p == ',') ++p;
+        skipSpaces(p, end);
+    }
+
+    int day, month, year, hour, minute, second = 0, offset;
+    if(!readNumber(p, end, 1, 2, day)) return 0;
+    skipSpaces(p, end);
+    if((month = readMonthName(p, end)) == 0) return 0;
+    skipSpaces(p, end);
+
+    const char* yearStart = p;
+    if(!readNumber(p, end, 2, 4, year)) return 0;
+    if(p - yearStart == 2) year += (year < 50) ? 2000 : 1900; //Two digit years from old feeds
+    skipSpaces(p, end);
+
+    if(!readNumber(p, end, 1, 2, hour) || p == end || *p++ != ':') return 0;
+    if(!readNumber(p, end, 2, 2, minute)) return 0;
+    if(p < end && *p == ':')
+    {
+        ++p;
+        if(!readNumber(p, end, 2, 2, second)) return 0;
+    }
+
+    if(!readRfc822Zone(p, end, offset)) return 0;
+    skipSpaces(p, end);
+    if(p != end) return 0;
+    return toEpoch(year, month, day, hour, minute, second, offset);
+}
+
+int64_t parseFeedDate(std::string_view text)
+{
+    const char* p = text.data();
+    const char* end = p + text.size();
+    skipSpaces(p, end);
+    while(end > p && std::isspace((unsigned char)end[-1])) --end;
+    if(p == end) return 0;
+
+    //RFC 3339 dates start with a four digit year and a dash, RFC 822 dates start with the day
+    if(end - p >= 5 && std::isdigit((unsigned char)p[0]) && std::isdigit((unsigned char)p[3]) && p[4] == '-') return parseRfc3339(p, end);
+    return parseRfc822(p, end);
+}
@@ -52,14 +52,32 @@ void RssView::init(unsigned int w, unsigned int h)
     normal = io.Fonts->AddFontFromFileTTF("times-new-roman.ttf", 18.f);
     //bold = io.Fonts->AddFontFromFileTTF("FreeSansBold-Xgdd.ttf", 24);
 
-    bgProcess = std::async(std::launch::async, &RssFeedManager::loadChannelsFromRecord, &feedManager); //Load all RSS feeds in the background
-    processString = "Loading RSS channels...";
+    wakeEventType = SDL_RegisterEvents(1); //Event type that background threads push to wake the render loop
+    imageLoader.onReady = [this](void) { wake(); }; //Draw a frame when a decoded image is ready to upload
+    feedManager.onPublish = [this](void) { wake(); }; //Draw a frame when the channel list changes
+
+    runInBackground([this](void) 
+    { 
+        feedManager.loadChannelsFromRecord(); 
+        feedManager.startRefreshing(); //Keep refreshing channels as they become due
+    }, "Loading RSS channels..."); //Load all RSS feeds in the background
 
 
 }
 
 RssView::~RssView()
 {
+    //Stop every thread that can call wake() before SDL is shut down. The background task has to finish
+    //first because loading the channels ends by starting the refresh thread
+    if(bgProcess.valid()) bgProcess.wait();
+    feedManager.stopRefreshing();
+    imageLoader.stop();
+    feedManager.onPublish = nullptr; //Nothing can call these now, and the members outlive SDL
+    imageLoader.onReady = nullptr;
+
+    textures.clear(); //Free every image texture before the OpenGL context is gone
+    if(fullImage.txID != 0) glDeleteTextures(1, &fullImage.txID);
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown(); //Shutdown Dear ImGui
     ImGui::DestroyContext();
@@ -81,9 +99,9 @@ void RssView::feedSelectWin(void)
 
     ImGui::Text("RSS Channels");
     ImGui::ListBoxHeader("", ImVec2(paneSize.x, paneSize.y * (3 / 4))); //Start drawing to a new listbox of RSS channels
-    for(auto& ch : feedManager.channels)
+    for(const auto& ch : *frameChannels)
     {
-        if(ImGui::Selectable(ch.title.c_str())) //If the user selects this RSS channel, display it
+        if(ImGui::Selectable(ch->title.c_str())) //If the user selects this RSS channel, display it
         {
             displayedFeed = idx;
         }
@@ -93,8 +111,25 @@ void RssView::feedSelectWin(void)
 
     if(ImGui::Button("Remove selected RSS feed")) //If the user wants to delete this subscription
     {
-        if(displayedFeed < feedManager.channels.size()) //Only remove the channel if it is valid
-            feedManager.removeChannel(feedManager.channels[displayedFeed].title); //Remove the channel with the specified index
+        if(displayedFeed < frameChannels->size()) //Only remove the channel if it is valid
+        {
+            const RssChannel& removed = *(*frameChannels)[displayedFeed];
+
+            std::unordered_set<std::string_view> stillShown; //Images that another channel shows too, they must stay loaded
+            for(const auto& ch : *frameChannels)
+            {
+                if(ch.get() == &removed) continue;
+                for(const auto& item : ch->items) stillShown.insert(item.enclosure.url);
+            }
+            for(const auto& item : removed.items) //Free the images that only this channel shows, nothing will draw them again
+            {
+                if(item.enclosure.url.empty() || stillShown.count(item.enclosure.url) != 0) continue;
+                std::string url(item.enclosure.url);
+                textures.release(url);
+                wantedImages.erase(url);
+            }
+            feedManager.removeChannel(removed.title); //Remove the channel with the specified index
+        }
     }
 
     ImGui::Spacing();
@@ -107,8 +142,8 @@ void RssView::feedSelectWin(void)
     {
         if(bgProcess.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) //If the background process is done, launch a new one
         {
-            bgProcess = std::async(std::launch::async, &RssFeedManager::addChannel, &feedManager, rssUrl); //Add the channel to our list of feeds
-            processString = "Adding RSS Feed From " + rssUrl; //Set the process string to explain what the user is waiting for
+            std::string url = rssUrl;
+            runInBackground([this, url](void) { feedManager.addChannel(url); }, "Adding RSS Feed From " + rssUrl); //Add the channel to our list of feeds
             rssUrl.clear(); //Empty the URL field
         }
     }
@@ -117,10 +152,21 @@ void RssView::feedSelectWin(void)
     ImGui::End();
 }
 
+/**
+ * @brief Function to get the key that an item's measured height is kept by
+ *
+ * @param item The item
+ * @return std::string The guid of the item, or its link if it has no guid
+ */
+static std::string heightKey(const RssItem& item)
+{
+    return std::string(item.guid.empty() ? item.link : item.guid);
+}
+
 void RssView::displayChannel(void)
 {
-    if(displayedFeed >= feedManager.channels.size()) return; //Don't display anything if the index is invalid
-    RssChannel& displayed = feedManager.channels[displayedFeed]; //Get a reference to the displayed channel 
+    if(displayedFeed >= frameChannels->size()) return; //Don't display anything if the index is invalid
+    const RssChannel& displayed = *(*frameChannels)[displayedFeed]; //Get a reference to the displayed channel, the snapshot keeps it alive for the whole frame
 
     ImVec2 paneSize = ImVec2(ImGui::GetIO().DisplaySize.x * 3.f/4.f, ImGui::GetIO().DisplaySize.y - mainMenuSize.y); //Size of this pane
 
@@ -129,6 +175,7 @@ void RssView::displayChannel(void)
     ImGui::Begin(displayed.title.c_str(), (bool*)0, ImGuiWindowFlags_::ImGuiWindowFlags_NoMove | ImGuiWindowFlags_::ImGuiWindowFlags_NoResize); //Begin drawing to a window with the name of the RSS channel
 
     maxImageWidth = (size_t)( (int)paneSize.x / 3); //Set images to be 1 / 3 the size of the window
+    textures.atlasMaxWidth = (int)maxImageWidth; //Thumbnails are shrunk to this width, so they all fit in the shared atlas pages
 
     /*if(displayed.image.filled)
     {
@@ -147,56 +194,270 @@ void RssView::displayChannel(void)
 
     ImGui::Separator(); //Sepatate the channel attributes and the items
 
-    size_t idx = 0;
-    for(RssItem& item : displayed.items) //Display every item in the channel
+    //Throw away the measured heights if a different channel is shown or anything that changes how items wrap
+    if(itemLayout.link != displayed.link || itemLayout.paneWidth != paneSize.x || itemLayout.imageWidth != maxImageWidth)
     {
-        ImGui::TextColored(ImVec4(0.97f, 0.76f, 0.01f, 1.0f), "Title: %s", item.title.c_str()); //Draw the title of the item
-        ImGui::TextColored(ImVec4(0.0f, 0.0f, 1.0f, 1.0f), "Link: %s", item.link.c_str());      //Draw the link of the item
-        if(ImGui::IsItemClicked()) //Check if the link was clicked and open a browser to view it
-        {
-            #ifdef _WIN32
-            ShellExecuteA(NULL, "open", item.link.c_str(), NULL, NULL, SW_SHOWNORMAL);
-            #endif
-        }
+        itemLayout.link = displayed.link;
+        itemLayout.paneWidth = paneSize.x;
+        itemLayout.imageWidth = maxImageWidth;
+        itemLayout.byGuid.clear();
+        itemLayout.channel.reset(); //Look up the heights again below
+    }
+
+    //Every refresh publishes a new channel object whose items can be added, trimmed, or moved, so find each item's height by its guid and list the shown items again
+    if(itemLayout.channel.get() != &displayed)
+    {
+        itemLayout.channel = (*frameChannels)[displayedFeed];
+        itemLayout.heights.assign(displayed.items.size(), 0.f);
 
-        ImGui::TextWrapped("Description: %s", item.description.c_str());
-        if(item.enclosure.filled) //If the image is filled with data, draw it
+        std::unordered_map<std::string, float> kept; //Only keep the heights of items that are still in the channel
+        for(size_t i = 0; i < displayed.items.size(); ++i)
         {
-            ImGui::Image((void *)(intptr_t)item.enclosure.txID, ImVec2((float)maxImageWidth, ((float)item.enclosure.height / (float)item.enclosure.width) * maxImageWidth)); //Draw the image
-            ImGui::TextWrapped("Description: %s", item.enclosure.description.c_str()); //Draw the description of the image
+            auto found = itemLayout.byGuid.find(heightKey(displayed.items[i]));
+            if(found == itemLayout.byGuid.end()) continue;
+            itemLayout.heights[i] = found->second;
+            kept.insert(*found);
         }
-        else if(!item.enclosure.url.empty()) //If there is a url to download image data from, prompt the user to download it
+        itemLayout.byGuid.swap(kept);
+        itemLayout.since = -1;
+        itemLayout.dirty = true;
+    }
+
+    //The time window only moves once a minute, so the shown items are only listed again when it moves or the settings change
+    int64_t nowMinutes = std::chrono::duration_cast<std::chrono::minutes>(std::chrono::system_clock::now().time_since_epoch()).count();
+    int64_t since = (showHours > 0) ? (nowMinutes - (int64_t)showHours * 60) * 60 : 0;
+    if(itemLayout.newestFirst != bNewestFirst || itemLayout.since != since)
+    {
+        itemLayout.newestFirst = bNewestFirst;
+        itemLayout.since = since;
+
+        //The channel keeps its items sorted by date, so the newest items are always the start of byDate
+        size_t shown = (since > 0) ? displayed.countSince(since) : displayed.byDate.size();
+        if(bNewestFirst || since > 0) itemLayout.order.assign(displayed.byDate.begin(), displayed.byDate.begin() + shown);
+        if(!bNewestFirst)
         {
-            if(ImGui::Button( ("Download Image #" + std::to_string(idx) ).c_str())) //Prompt the user to download the image
+            if(since > 0) std::sort(itemLayout.order.begin(), itemLayout.order.end()); //Put the recent items back in feed order
+            else
             {
-                item.enclosure.loadImgFromUrl(item.enclosure.url); //Load the image at the URL
+                itemLayout.order.resize(displayed.items.size());
+                std::iota(itemLayout.order.begin(), itemLayout.order.end(), 0);
             }
         }
-        idx++;
-        ImGui::Separator();
-        ImGui::Spacing();
+        itemLayout.dirty = true;
+    }
+
+    const std::vector<uint32_t>& order = itemLayout.order;
+    if(itemLayout.dirty) //Add up the item heights, using a guess for items that were never drawn
+    {
+        float guess = ImGui::GetTextLineHeightWithSpacing() * 4.f; //About the height of an item with a one line description
+        itemLayout.offsets.resize(order.size() + 1);
+        itemLayout.offsets[0] = 0.f;
+        for(size_t i = 0; i < order.size(); ++i)
+        {
+            float height = itemLayout.heights[order[i]];
+            itemLayout.offsets[i + 1] = itemLayout.offsets[i] + ( (height > 0.f) ? height : guess );
+        }
+        itemLayout.dirty = false;
     }
 
+    float listTop = ImGui::GetCursorPosY(); //Where the first item starts in the window
+    float viewTop = ImGui::GetScrollY() - listTop; //The visible part of the list
+    float viewBottom = viewTop + ImGui::GetWindowHeight();
+
+    //Find the first item that is at least partly visible, then draw items until one starts below the window
+    size_t idx = (size_t)(std::upper_bound(itemLayout.offsets.begin(), itemLayout.offsets.end() - 1, viewTop) - itemLayout.offsets.begin());
+    idx = (idx == 0) ? 0 : idx - 1;
+
+    ImGui::SetCursorPosY(listTop + itemLayout.offsets[idx]); //Skip over every item above the window
+    for(; idx < order.size() && itemLayout.offsets[idx] < viewBottom; ++idx)
+    {
+        float itemTop = ImGui::GetCursorPosY();
+        drawItem(displayed.items[order[idx]], order[idx]);
+
+        float height = ImGui::GetCursorPosY() - itemTop; //Remember the real height, it changes when an image loads
+        if(height != itemLayout.heights[order[idx]])
+        {
+            itemLayout.heights[order[idx]] = height;
+            itemLayout.byGuid[heightKey(displayed.items[order[idx]])] = height;
+            itemLayout.dirty = true;
+        }
+    }
+
+    ImGui::SetCursorPosY(listTop + itemLayout.offsets.back()); //Leave room for every item below the window so the scroll bar is the right size
+    ImGui::Dummy(ImVec2(0.f, 0.f));
+
     ImGui::End();
 }
 
+void RssView::drawItem(const RssItem& item, size_t idx)
+{
+    ImGui::TextColored(ImVec4(0.97f, 0.76f, 0.01f, 1.0f), "Title: %s", item.title.data()); //Draw the title of the item
+    ImGui::TextColored(ImVec4(0.0f, 0.0f, 1.0f, 1.0f), "Link: %s", item.link.data());      //Draw the link of the item
+    if(ImGui::IsItemClicked()) //Check if the link was clicked and open a browser to view it
+    {
+        #ifdef _WIN32
+        ShellExecuteA(NULL, "open", item.link.data(), NULL, NULL, SW_SHOWNORMAL);
+        #endif
+    }
+
+    ImGui::TextWrapped("Description: %s", item.description.data());
+    std::string url(item.enclosure.url); //The URL of the item's image, empty if it has none
+    const RssTexture* tex = (url.empty()) ? NULL : textures.draw(url); //Find the uploaded image for this item
+    if(tex != NULL) //If the image is loaded, draw it
+    {
+        ImGui::Image((void *)(intptr_t)tex->txID, ImVec2((float)maxImageWidth, ((float)tex->height / (float)tex->width) * maxImageWidth), ImVec2(tex->u0, tex->v0), ImVec2(tex->u1, tex->v1)); //Draw the image, which can be part of an atlas page
+        ImGui::TextWrapped("Description: %s", item.enclosure.description.data()); //Draw the description of the image
+        if(ImGui::Button( ("View Full Size #" + std::to_string(idx) ).c_str())) //The thumbnail is shrunk, so let the user see every pixel
+        {
+            showFullImage(url);
+        }
+    }
+    else if(!url.empty()) //If there is a url to download image data from, prompt the user to download it
+    {
+        bool wanted = wantedImages.count(url) != 0; //If the user loaded this image before and its texture was evicted
+        if(wanted || imageLoader.isPending(url)) //Show that the image is still downloading
+        {
+            if(wanted) imageLoader.request(url, (int)maxImageWidth); //Reload the evicted image, usually from the image cache on disk
+            ImGui::Text("Loading Image #%zu...", idx);
+        }
+        else if(ImGui::Button( ("Download Image #" + std::to_string(idx) ).c_str())) //Prompt the user to download the image
+        {
+            wantedImages.insert(url);
+            imageLoader.request(url, (int)maxImageWidth); //Load the image at the URL in the background, shrunk to the width it is drawn at
+        }
+    }
+    ImGui::Separator();
+    ImGui::Spacing();
+}
 
-void RssView::doLoop(void)
+bool RssView::uploadReadyImages(void)
 {
-    //if(!bgProcess.valid())
-        //bgProcess = std::async(unused);
+    auto start = std::chrono::steady_clock::now(); //When uploading started this frame
+    RssImageData img; //The decoded image taken from the loader
 
+    while(imageLoader.popReady(img)) //Upload images until the queue is empty or the time budget is used
+    {
+        if(!img.error.empty()) 
+        {
+            logE("Failed to load image from %s: %s", img.url.c_str(), img.error.c_str());
+            if(!img.fullSize) wantedImages.erase(img.url); //Don't keep reloading an image that fails
+        }
+        else if(img.fullSize) //Only keep the full size image if the user is still waiting for it
+        {
+            if(img.url == fullImageUrl && fullImage.txID == 0) fullImage = RssTextureCache::upload(img);
+        }
+        else if(wantedImages.count(img.url) != 0) //Skip images of channels that were removed while they loaded
+        {
+            textures.insert(img.url, img);
+        }
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if(elapsed.count() >= uploadBudgetMs) return true; //Leave the rest of the images for the next frame
+    }
+    return false;
+}
+
+void RssView::showFullImage(const std::string& url)
+{
+    if(url == fullImageUrl) return; //Already shown or loading
+    if(fullImage.txID != 0) glDeleteTextures(1, &fullImage.txID); //Full size images are big, so only ever keep one
+    fullImage = {0, 0, 0};
+
+    fullImageUrl = url;
+    imageLoader.request(url); //Load the image without shrinking it
+}
+
+void RssView::fullImageWin(void)
+{
+    if(fullImageUrl.empty()) return;
+
+    bool open = true; //Set to false when the user closes the window
+    ImGui::SetNextWindowSize(ImVec2(ImGui::GetIO().DisplaySize.x / 2, ImGui::GetIO().DisplaySize.y / 2), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Full Size Image", &open, ImGuiWindowFlags_HorizontalScrollbar); //Scroll around the image instead of shrinking it
+    if(fullImage.txID != 0)
+    {
+        ImGui::Image((void *)(intptr_t)fullImage.txID, ImVec2((float)fullImage.width, (float)fullImage.height)); //Draw the image at its own size
+    }
+    else if(imageLoader.isPending(fullImageUrl, true))
+    {
+        ImGui::Text("Loading full size image...");
+    }
+    else //The image failed to load and the error was logged
+    {
+        ImGui::Text("Failed to load %s", fullImageUrl.c_str());
+    }
+    ImGui::End();
+
+    if(!open) //Free the texture as soon as the window is closed
+    {
+        if(fullImage.txID != 0) glDeleteTextures(1, &fullImage.txID);
+        fullImage = {0, 0, 0};
+        fullImageUrl.clear();
+    }
+}
+
+void RssView::runInBackground(std::function<void(void)> task, const std::string& description)
+{
+    processString = description; //Set the process string to explain what the user is waiting for
+    bgProcess = std::async(std::launch::async, [this, task](void)
+    {
+        try
+        {
+            task();
+        }
+        catch(...) //Still wake the render loop if the task failed, the error stays in the future
+        {
+            wake();
+            throw;
+        }
+        wake();
+    });
+}
+
+void RssView::wake(void)
+{
+    SDL_Event wakeEvent = {}; //An empty user event, it only needs to make SDL_WaitEventTimeout return
+    wakeEvent.type = wakeEventType;
+    SDL_PushEvent(&wakeEvent);
+}
+
+void RssView::doLoop(void)
+{
     bool run = true; //If we should continue in the rendering loop
     SDL_Event userInput; //SDL input event queue to send to Dear ImGui
+    int activeFrames = 1; //How many more frames to draw without waiting, Dear ImGui needs a couple of frames to settle after any input
+    bool uploadsLeft = false; //If there were more decoded images than the upload budget allowed last frame
     
     while(run) //Start main loop
     {
-        while(SDL_PollEvent(&userInput)) //Poll through all input events in SDL2
+        bool gotEvent; //If there is an event in userInput to handle
+        if(activeFrames > 0 || uploadsLeft) //Something is still changing, so don't wait
+        {
+            gotEvent = SDL_PollEvent(&userInput);
+        }
+        else if(maxIdleFps > 0) //Sleep until there is input, a background task wakes us, or it's time for an idle frame
+        {
+            gotEvent = SDL_WaitEventTimeout(&userInput, 1000 / maxIdleFps);
+        }
+        else //Sleep until there is input or a background task wakes us
+        {
+            gotEvent = SDL_WaitEvent(&userInput);
+        }
+
+        while(gotEvent) //Handle the event that woke us and all other input events in SDL2
         {
             ImGui_ImplSDL2_ProcessEvent(&userInput); //Send the event to Dear ImGui
             if(userInput.type == SDL_QUIT || (userInput.type == SDL_WINDOWEVENT_CLOSE && userInput.window.windowID == SDL_GetWindowID(win))) //Quit if the user wants to
             run = false;
+
+            activeFrames = 3; //Draw a few frames so Dear ImGui can react to the event
+            gotEvent = SDL_PollEvent(&userInput);
         }
+        if(activeFrames > 0) activeFrames--;
+
+        textures.nextFrame(); //Evict the textures that haven't been drawn for the longest if there are too many
+        uploadsLeft = uploadReadyImages(); //Upload any images that finished loading in the background
+        frameChannels = feedManager.snapshot(); //Take one snapshot of the channel list for this whole frame
 
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplSDL2_NewFrame(win);
@@ -230,12 +491,24 @@ void RssView::doLoop(void)
         {
             ImGui::Begin("Settings", &bShowSettings); //Show settings window if the user wants to edit settings
             ImGui::Checkbox("Load all images when loading a new RSS feed", &bLoadAllImages); //Allow the user to toggle if we should load every image when loading a new feed
+            ImGui::SliderInt("Idle frame rate", &maxIdleFps, 0, 60); //Allow the user to pick how often to redraw when nothing is happening
+            if(ImGui::SliderInt("Image cache size (MiB)", &imageCacheMiB, 8, 1024)) //Images past this size are deleted, least recently used first
+            {
+                imageLoader.cache.quotaBytes = (size_t)imageCacheMiB * 1024 * 1024;
+            }
+            if(ImGui::SliderInt("Image memory (MiB)", &textureMiB, 32, 1024)) //Images past this size are unloaded, least recently drawn first, and reload when they are drawn again
+            {
+                textures.budgetBytes = (size_t)textureMiB * 1024 * 1024;
+            }
+            ImGui::Checkbox("Show newest items first", &bNewestFirst);
+            ImGui::SliderInt("Only show items from the last hours (0 for all)", &showHours, 0, 168); //Filter items by their publication date
             ImGui::End();
         }
         
 
         feedSelectWin();
         displayChannel();
+        fullImageWin();
 
         ImGui::Render();
         glViewport(0, 0, (int)ImGui::GetIO().DisplaySize.x, (int)ImGui::GetIO().DisplaySize.y); //Set the OpenGL rendering size to the window size
@@ -0,0 +1,356 @@
+#include "include/imgload.hpp"
+
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+/**
+ * @brief The first line of every cached image file, change it when the layout of the file changes
+ */
+static const char IMAGE_CACHE_HEADER[] = "#GoodNews image v2";
+
+/**
+ * @brief Function to write the time an image was fetched for the header of its cache file. The time always
+ * has the same number of digits so that a revalidation can overwrite it without rewriting the image
+ *
+ * @param fetchedAt Seconds since 1970
+ * @return std::string The time as 20 digits followed by a newline
+ */
+static std::string fetchedAtLine(int64_t fetchedAt)
+{
+    char line[32];
+    snprintf(line, sizeof(line), "%020lld\n", (long long)std::max<int64_t>(fetchedAt, 0));
+    return line;
+}
+
+/**
+ * @brief The source pixels that each output pixel of one direction is averaged from
+ * 
+ */
+struct ShrinkWeights
+{
+    std::vector<int> first;      //The first source pixel of each output pixel
+    std::vector<int> count;      //The number of source pixels of each output pixel
+    std::vector<int> offset;     //Where the weights of each output pixel start in weights
+    std::vector<float> weights;  //How much each source pixel covers of the output pixel, adding up to 1
+};
+
+/**
+ * @brief Function to find the source pixels covered by each output pixel when shrinking one direction
+ * 
+ * @param srcSize The number of source pixels
+ * @param dstSize The number of output pixels, at most srcSize
+ * @return ShrinkWeights The source pixels and weights of every output pixel
+ */
+static ShrinkWeights shrinkWeights(int srcSize, int dstSize)
+{
+    ShrinkWeights w;
+    double scale = (double)srcSize / dstSize; //How many source pixels each output pixel covers
+    for(int i = 0; i < dstSize; ++i)
+    {
+        double start = i * scale, end = (i + 1) * scale;
+        int first = (int)start;
+        int last = std::min((int)std::ceil(end), srcSize); //One past the last covered pixel
+
+        w.first.push_back(first);
+        w.count.push_back(last - first);
+        w.offset.push_back((int)w.weights.size());
+        for(int p = first; p < last; ++p) //Pixels at the edges are only partly covered
+        {
+            double covered = std::min(end, (double)p + 1) - std::max(start, (double)p);
+            w.weights.push_back((float)(covered / scale));
+        }
+    }
+    return w;
+}
+
+void shrinkImage(RssImageData& img, int maxWidth)
+{
+    if(maxWidth <= 0 || img.width <= maxWidth || img.height <= 0) return;
+
+    int dstWidth = maxWidth;
+    int dstHeight = std::max(1, (int)((int64_t)img.height * dstWidth / img.width)); //Keep the aspect ratio
+
+    //Shrink each row first, keeping every row so the columns can be shrunk after
+    ShrinkWeights across = shrinkWeights(img.width, dstWidth);
+    std::vector<float> rows((size_t)dstWidth * img.height * 4);
+    for(int y = 0; y < img.height; ++y)
+    {
+        const unsigned char* src = img.pixels.data() + (size_t)y * img.width * 4;
+        float* dst = rows.data() + (size_t)y * dstWidth * 4;
+        for(int x = 0; x < dstWidth; ++x)
+        {
+            float sum[4] = {0.f, 0.f, 0.f, 0.f};
+            const unsigned char* px = src + (size_t)across.first[x] * 4;
+            const float* weight = across.weights.data() + across.offset[x];
+            for(int k = 0; k < across.count[x]; ++k, px += 4)
+            {
+                float alpha = weight[k] * px[3]; //Premultiply by alpha so the colour of transparent pixels doesn't bleed into the edges
+                for(int c = 0; c < 3; ++c) sum[c] += alpha * px[c];
+                sum[3] += alpha;
+            }
+            for(int c = 0; c < 4; ++c) dst[x * 4 + c] = sum[c];
+        }
+    }
+
+    //Then shrink the columns, adding whole shrunk rows together so the inner loop runs over one long row
+    ShrinkWeights down = shrinkWeights(img.height, dstHeight);
+    size_t rowSize = (size_t)dstWidth * 4;
+    std::vector<float> sum(rowSize);
+    std::vector<unsigned char> pixels(rowSize * dstHeight);
+    for(int y = 0; y < dstHeight; ++y)
+    {
+        std::fill(sum.begin(), sum.end(), 0.f);
+        for(int k = 0; k < down.count[y]; ++k)
+        {
+            float weight = down.weights[down.offset[y] + k];
+            const float* row = rows.data() + (size_t)(down.first[y] + k) * rowSize;
+            for(size_t i = 0; i < rowSize; ++i) sum[i] += weight * row[i];
+        }
+
+        unsigned char* dst = pixels.data() + (size_t)y * rowSize;
+        for(size_t i = 0; i < rowSize; i += 4) //Divide the alpha back out of the colour
+        {
+            float alpha = sum[i + 3];
+            float unpremultiply = (alpha > 0.f) ? 1.f / alpha : 0.f;
+            for(int c = 0; c < 3; ++c) dst[i + c] = (unsigned char)std::min(sum[i + c] * unpremultiply + 0.5f, 255.f);
+            dst[i + 3] = (unsigned char)std::min(alpha + 0.5f, 255.f);
+        }
+    }
+
+    img.width = dstWidth;
+    img.height = dstHeight;
+    img.pixels.swap(pixels);
+    img.fullSize = false;
+}
+
+RssImageCache::RssImageCache(const std::string& t_directory, size_t t_quotaBytes) : quotaBytes(t_quotaBytes), directory(t_directory)
+{
+
+}
+
+void RssImageCache::scan(void)
+{
+    scanned = true;
+    std::error_code ec;
+    for(std::filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+    {
+        if(it->path().extension() != ".img") continue; //Skip files that were being written when the program stopped
+
+        FileInfo info;
+        info.size = it->file_size(ec);
+        if(ec) continue;
+        info.lastUsed = it->last_write_time(ec);
+        if(ec) continue;
+
+        files[it->path().filename().string()] = info;
+        totalBytes += info.size;
+    }
+}
+
+bool RssImageCache::load(const std::string& url, Entry& out)
+{
+    std::string name = urlHash(url) + ".img";
+    std::string path = pathFor(name);
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if(file == NULL) return false;
+
+    std::string data; //The whole file, it is only as big as the image
+    char buffer[64 * 1024];
+    size_t read;
+    while((read = fread(buffer, 1, sizeof(buffer), file)) > 0) data.append(buffer, read);
+    fclose(file);
+
+    //Read the header lines: header, URL, ETag, Last-Modified, and the time it was fetched
+    std::string lines[5];
+    size_t pos = 0;
+    for(std::string& line : lines)
+    {
+        size_t end = data.find('\n', pos);
+        if(end == std::string::npos) return false;
+        line = data.substr(pos, end - pos);
+        pos = end + 1;
+    }
+    if(lines[0] != IMAGE_CACHE_HEADER || lines[1] != url) return false; //Another URL with the same hash, or an old file
+
+    out.etag = lines[2];
+    out.lastModified = lines[3];
+    out.fetchedAt = std::strtoll(lines[4].c_str(), NULL, 10);
+    out.body = data.substr(pos);
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if(!scanned) scan();
+    std::error_code ec;
+    auto now = std::filesystem::file_time_type::clock::now();
+    std::filesystem::last_write_time(path, now, ec); //Remember the use on disk too, so the order survives a restart
+    files[name].lastUsed = now;
+    return true;
+}
+
+void RssImageCache::store(const std::string& url, const Entry& entry)
+{
+    if(url.find('\n') != std::string::npos) return; //The URL has to fit on one line of the header
+
+    std::string name = urlHash(url) + ".img";
+    std::string data = std::string(IMAGE_CACHE_HEADER) + "\n" + url + "\n" + entry.etag + "\n" + entry.lastModified + "\n" + fetchedAtLine(entry.fetchedAt);
+    data += entry.body;
+    if(data.size() > quotaBytes) return; //It would have to be deleted right away
+
+    std::lock_guard<std::mutex> lock(cacheMutex); //Hold the lock while writing so two threads don't write the same file
+    if(!scanned) scan();
+    if(!writeFileAtomic(pathFor(name), data.data(), data.size()))
+    {
+        logW("Failed to write image %s to the image cache", url.c_str());
+        return;
+    }
+
+    FileInfo& info = files[name];
+    totalBytes = totalBytes - info.size + data.size(); //Replace the size of the old copy
+    info.size = data.size();
+    info.lastUsed = std::filesystem::file_time_type::clock::now();
+    evict(name);
+}
+
+void RssImageCache::touch(const std::string& url, const Entry& entry)
+{
+    std::string name = urlHash(url) + ".img";
+    std::string path = pathFor(name);
+    std::string header = std::string(IMAGE_CACHE_HEADER) + "\n" + url + "\n" + entry.etag + "\n" + entry.lastModified + "\n"; //Everything before the fetch time
+    std::string fetched = fetchedAtLine(entry.fetchedAt);
+
+    bool updated = false;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex); //store replaces files while holding the lock, so the file can't change under us
+        if(!scanned) scan();
+
+        FILE* file = fopen(path.c_str(), "r+b");
+        if(file != NULL)
+        {
+            //Only overwrite the time if the file still has the same validators, another thread could have stored a new download
+            std::string onDisk(header.size() + fetched.size(), '\0');
+            if(fread(&onDisk[0], 1, onDisk.size(), file) == onDisk.size() && onDisk.compare(0, header.size(), header) == 0 && onDisk.back() == '\n')
+            {
+                updated = fseek(file, (long)header.size(), SEEK_SET) == 0 && fwrite(fetched.data(), 1, fetched.size(), file) == fetched.size();
+            }
+            updated = (fclose(file) == 0) && updated;
+        }
+        if(updated) files[name].lastUsed = std::filesystem::file_time_type::clock::now(); //Writing the file set its modification time too
+    }
+
+    if(!updated) store(url, entry); //The file is gone or changed, so write the whole image
+}
+
+void RssImageCache::evict(const std::string& keep)
+{
+    while(totalBytes > quotaBytes && files.size() > 1)
+    {
+        auto oldest = files.end(); //Find the least recently used image, the cache only holds a few thousand files
+        for(auto it = files.begin(); it != files.end(); ++it)
+        {
+            if(it->first != keep && (oldest == files.end() || it->second.lastUsed < oldest->second.lastUsed)) oldest = it;
+        }
+
+        std::error_code ec;
+        std::filesystem::remove(pathFor(oldest->first), ec);
+        totalBytes -= oldest->second.size;
+        files.erase(oldest);
+    }
+}
+
+bool RssImageCache::isFresh(const Entry& entry) const
+{
+    int64_t now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    return now - entry.fetchedAt < revalidateAfter;
+}
+
+RssImageLoader::RssImageLoader(size_t threadCount)
+{
+    for(size_t i = 0; i < threadCount; ++i)
+    {
+        workers.emplace_back(&RssImageLoader::workerLoop, this);
+    }
+}
+
+RssImageLoader::~RssImageLoader()
+{
+    stop();
+}
+
+void RssImageLoader::stop(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+        jobs.clear(); //Don't bother loading images that are still queued
+    }
+    jobCv.notify_all();
+
+    for(std::thread& worker : workers) 
+    {
+        if(worker.joinable()) worker.join(); //Wait for any images in progress to finish
+    }
+}
+
+void RssImageLoader::request(const std::string& url, int maxWidth)
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if(!pending.insert(pendingKey(url, maxWidth <= 0)).second) return; //Already loading this image
+        jobs.push_back(Job{url, maxWidth});
+    }
+    jobCv.notify_one();
+}
+
+bool RssImageLoader::isPending(const std::string& url, bool fullSize)
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return pending.count(pendingKey(url, fullSize)) != 0;
+}
+
+bool RssImageLoader::popReady(RssImageData& out)
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if(ready.empty()) return false;
+
+    out = std::move(ready.front());
+    ready.pop_front();
+    pending.erase(pendingKey(out.url, out.fullSize)); //The image can be requested again now that it's out of the queue
+    return true;
+}
+
+void RssImageLoader::workerLoop(void)
+{
+    while(true)
+    {
+        Job job; //The image to load
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            jobCv.wait(lock, [this] { return stopping || !jobs.empty(); }); //Sleep until there is an image to load
+            if(stopping) return;
+
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        RssImageData img; 
+        try
+        {
+            img = RssImage::loadImgFromUrl(job.url, &cache); //Download or read the image and decode it without holding the lock
+            shrinkImage(img, job.maxWidth); //Only upload as many pixels as are drawn
+        }
+        catch(const std::exception& e) //Send the error to the render thread with the image
+        {
+            img.url = job.url;
+            img.error = e.what();
+        }
+        img.fullSize = (job.maxWidth <= 0); //Say which request this is, even for a small image that wasn't shrunk
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            ready.push_back(std::move(img));
+        }
+        if(onReady) onReady();
+    }
+}
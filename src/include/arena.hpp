@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <memory>
+
+/**
+ * @brief Class that owns all of the text of one channel in a few large blocks,
+ * items keep string_views into the arena instead of each owning its own strings.
+ * Every string stored in the arena is followed by a null character, so views from
+ * it can be passed to C style functions with data()
+ * 
+ */
+class RssArena
+{
+public:
+
+    /**
+     * @brief Construct a new empty arena
+     * 
+     * @param blockSize The size of each block that small strings are packed into
+     */
+    RssArena(size_t blockSize = 64 * 1024);
+
+    /**
+     * @brief Method to copy a string into the arena
+     * 
+     * @param str The characters to copy
+     * @param size The number of characters to copy
+     * @return std::string_view A view of the copy, followed by a null character
+     */
+    std::string_view store(const char* str, size_t size);
+
+    /**
+     * @brief Method to reserve uninitialized bytes in the arena
+     * 
+     * @param size The number of bytes needed
+     * @return char* The first reserved byte, valid for as long as the arena is
+     */
+    char* allocate(size_t size);
+
+    /**
+     * @brief Method to keep an object alive for as long as the arena, used when
+     * views point into memory the arena doesn't own, like a mapped snapshot file
+     * 
+     * @param owner The object to keep alive
+     */
+    void keepAlive(std::shared_ptr<const void> owner);
+
+    size_t bytesUsed(void) const { return totalUsed; } //Bytes handed out by store and allocate
+
+private:
+
+    std::vector<std::unique_ptr<char[]>> blocks; //Every block, the last one is the one being filled
+    size_t blockSize;      //The size of new blocks for small strings
+    size_t blockUsed = 0;  //Bytes used in the last block
+    size_t blockCapacity = 0; //Size of the last block
+    size_t totalUsed = 0;
+
+    std::vector<std::shared_ptr<const void>> owners; //Objects that views into the arena also point into
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @brief Function to read the date of an item, like "Tue, 10 Jun 2003 04:00:00 GMT" from
+ * an RSS <pubDate> (RFC 822) or "2003-12-13T18:30:02Z" from an Atom or RSS 1.0 date (RFC 3339).
+ * Items keep the result, and items that are merged from the previous download keep theirs,
+ * so each date is only read once
+ *
+ * @param text The text of the date
+ * @return int64_t Seconds since 1970-01-01 in UTC, or 0 if the text isn't a date
+ */
+int64_t parseFeedDate(std::string_view text);
+
@@ -13,8 +13,37 @@
 
 #include <future> //For asynchronous processes not freezing the GUI
 #include <chrono>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm> //For finding the first visible item
+#include <numeric>   //For listing items in feed order
+#include <functional>
 
 #include "rss.hpp"
+#include "imgload.hpp"
+#include "texcache.hpp"
+
+/**
+ * @brief Cached heights of the items in the displayed channel, so that only
+ * the items that are on screen have to be laid out every frame
+ * 
+ */
+struct RssItemLayout
+{
+    std::shared_ptr<const RssChannel> channel; //The channel object that order and heights were listed from, kept alive so a new object can't reuse its address
+    std::string link;       //The link of the channel that the heights were measured for, the same feed keeps its heights across refreshes
+    float paneWidth = 0.f;  //The width of the channel pane when the heights were measured
+    size_t imageWidth = 0;  //The maximum image width when the heights were measured
+
+    bool newestFirst = false; //The order that the items are shown in
+    int64_t since = -1;       //Only items published since this time are shown, 0 to show every item and -1 if order must be listed again
+    std::vector<uint32_t> order; //Index of every shown item in the channel, in the order that they are drawn
+
+    std::unordered_map<std::string, float> byGuid; //Measured height of every item by its guid, so heights stay with their items when a refresh adds or trims items
+    std::vector<float> heights; //Measured height of every item by its index in channel, looked up from byGuid, 0 if the item hasn't been drawn yet
+    std::vector<float> offsets; //Y offset of every shown item from the top of the list, with the total height at the end
+    bool dirty = true;          //If a height changed and the offsets need to be added up again
+};
 
 /**
  * @brief Class that contains all methods for displaying RSS management
@@ -54,10 +83,40 @@ private:
     SDL_GLContext glContext; //The SDL2 OpenGL context object
 
     RssFeedManager feedManager; //The internal RSS feed manager object 
+    std::shared_ptr<const RssChannelList> frameChannels; //The channel list snapshot taken at the start of this frame, every window draws from it
     size_t displayedFeed;       //The feed that is displayed in the channel view panel
 
     size_t maxImageWidth = 200; //The maximum an image width can be
 
+    RssImageLoader imageLoader; //Downloads and decodes images off the render thread
+    RssTextureCache textures; //Every uploaded thumbnail by URL, shrunk to maxImageWidth
+    std::unordered_set<std::string> wantedImages; //The URLs of every image the user loaded, reloaded when they are drawn after being evicted
+    std::string fullImageUrl;          //The URL of the image shown at full size, empty if none is shown
+    RssTexture fullImage = {0, 0, 0};  //The full size image texture, the ID is 0 while it loads
+    double uploadBudgetMs = 4.0; //The most time each frame can spend uploading decoded images to OpenGL
+
+    /**
+     * @brief Method to upload images that the image loader finished decoding,
+     * stopping after uploadBudgetMs so that one frame never stalls on uploads
+     * 
+     * @return true if there are still decoded images waiting for the next frame
+     */
+    bool uploadReadyImages(void);
+
+    /**
+     * @brief Method to start loading an image at its full size and show it in its own window,
+     * replacing the full size image that is already shown
+     * 
+     * @param url The URL of the image
+     */
+    void showFullImage(const std::string& url);
+
+    /**
+     * @brief Method to display the full size image window if an image is being shown
+     * 
+     */
+    void fullImageWin(void);
+
     /**
      * @brief Method to display a window with list of all subscribed RSS channel titles
      * 
@@ -71,10 +130,43 @@ private:
      */
     void displayChannel(void);
 
+    /**
+     * @brief Method to draw one item of the displayed channel
+     * 
+     * @param item The item to draw
+     * @param idx The index of the item in the channel, used for unique button labels
+     */
+    void drawItem(const RssItem& item, size_t idx);
+
+    RssItemLayout itemLayout; //Item heights of the displayed channel
+
     std::future<void> bgProcess; //Background process to run asynchronously
     std::string processString;   //The string describing what the background process is doing
 
+    /**
+     * @brief Method to start the background process, waking the render loop 
+     * when it finishes so the process string goes away without waiting for input
+     * 
+     * @param task The function to run in the background
+     * @param description The string describing what the background process is doing
+     */
+    void runInBackground(std::function<void(void)> task, const std::string& description);
+
+    /**
+     * @brief Method to wake the render loop up from waiting for events, 
+     * safe to call from any thread
+     * 
+     */
+    void wake(void);
+
+    Uint32 wakeEventType = (Uint32)-1; //SDL user event type pushed by wake()
+    int maxIdleFps = 1; //How many frames per second to draw at most when nothing is happening, 0 to only draw when there are events
+
     bool bLoadAllImages = false; //If we should load every image in a channel by default
+    bool bNewestFirst = true;    //If items are shown newest first instead of in the order of the feed
+    int showHours = 0;           //Only show items published in this many hours, 0 to show every item
+    int imageCacheMiB = 64;      //The most disk space that downloaded images can use
+    int textureMiB = 128;        //The most video memory that image thumbnails can use
     bool bShowSettings = false;  //If we should show the settings screen\
 
     ImFont* bold = NULL;   //Dear ImGui bold font
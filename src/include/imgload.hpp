@@ -0,0 +1,221 @@
+#pragma once
+
+#include "rss.hpp"
+
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_set>
+#include <unordered_map>
+#include <functional>
+#include <atomic>
+#include <filesystem>
+
+/**
+ * @brief Function to shrink a decoded image so it is no wider than a width, keeping its aspect ratio.
+ * Every output pixel is the average of the source pixels that it covers (a box filter), done one 
+ * direction at a time with loops that compilers can vectorize. Colours are weighted by alpha so
+ * transparent pixels don't leave dark fringes around the edges
+ * 
+ * @param img The image to shrink in place, it isn't changed if it is already narrow enough
+ * @param maxWidth The widest that the image can be
+ */
+void shrinkImage(RssImageData& img, int maxWidth);
+
+/**
+ * @brief Class that keeps downloaded images on disk, one file per image named by a hash of its URL.
+ * Each file starts with the URL, the HTTP validators, and the fetch time of the download, followed by the image 
+ * exactly as it was downloaded. When the files use more than the quota, the least recently used
+ * images are deleted. Safe to use from many threads at once
+ * 
+ */
+class RssImageCache
+{
+public:
+
+    /**
+     * @brief One cached image
+     * 
+     */
+    struct Entry
+    {
+        std::string body;         //The encoded image as it was downloaded
+        std::string etag;         //The ETag of the download, sent back as If-None-Match
+        std::string lastModified; //The Last-Modified date of the download, sent back as If-Modified-Since
+        int64_t fetchedAt = 0;    //When the image was downloaded or last revalidated, in seconds since 1970
+    };
+
+    /**
+     * @brief Construct an image cache
+     * 
+     * @param directory The folder that the images are kept in, created when the first image is stored
+     * @param quotaBytes The most disk space that the images can use
+     */
+    RssImageCache(const std::string& directory = "cached/images", size_t quotaBytes = 64 * 1024 * 1024);
+
+    /**
+     * @brief Method to read a cached image and mark it as recently used
+     * 
+     * @param url The URL of the image
+     * @param out The cached image
+     * @return true if the image was cached
+     */
+    bool load(const std::string& url, Entry& out);
+
+    /**
+     * @brief Method to save an image, replacing any cached copy of the same URL, then
+     * delete the least recently used images until the cache fits in the quota
+     * 
+     * @param url The URL of the image
+     * @param entry The image and its validators
+     */
+    void store(const std::string& url, const Entry& entry);
+
+    /**
+     * @brief Method to save the new fetch time of a cached image that the server said didn't change,
+     * overwriting only the time in the file's header instead of writing the whole image again.
+     * Stores the whole entry if the file was deleted or replaced since it was loaded
+     * 
+     * @param url The URL of the image
+     * @param entry The image as it was loaded, with the new fetch time
+     */
+    void touch(const std::string& url, const Entry& entry);
+
+    /**
+     * @brief Method to check if a cached image can be used without asking the server if it changed
+     * 
+     * @param entry The cached image
+     * @return true if the image was downloaded or revalidated less than revalidateAfter seconds ago
+     */
+    bool isFresh(const Entry& entry) const;
+
+    std::atomic<size_t> quotaBytes;           //The most disk space that the images can use
+    std::atomic<int64_t> revalidateAfter{7 * 24 * 60 * 60}; //Seconds until a cached image is checked with a conditional request
+
+private:
+
+    /**
+     * @brief Method to read the size and last use of every cached file, the first time the cache is used
+     * 
+     */
+    void scan(void);
+
+    /**
+     * @brief Method to delete the least recently used images until the cache fits in the quota
+     * 
+     * @param keep The file name of an image that must not be deleted
+     */
+    void evict(const std::string& keep);
+
+    std::string pathFor(const std::string& name) const { return directory + "/" + name; } //The path of a file in the cache folder
+
+    /**
+     * @brief The size and last use of a cached file
+     * 
+     */
+    struct FileInfo
+    {
+        uintmax_t size = 0;
+        std::filesystem::file_time_type lastUsed; //The modification time of the file, which is set every time the image is used
+    };
+
+    std::string directory;
+    std::mutex cacheMutex; //Mutex for the file list, every worker thread loads images
+    std::unordered_map<std::string, FileInfo> files; //Every cached file by name
+    uintmax_t totalBytes = 0; //The size of every cached file added up
+    bool scanned = false;     //If the cache folder was read yet
+};
+
+/**
+ * @brief Class that downloads and decodes images on a pool of worker threads,
+ * decoded images wait in a queue until the render thread takes them to upload
+ * 
+ */
+class RssImageLoader
+{
+public:
+
+    /**
+     * @brief Construct a new image loader and start the worker threads
+     * 
+     * @param threadCount The number of images that can be loading at once
+     */
+    RssImageLoader(size_t threadCount = 4);
+
+    ~RssImageLoader(); //Stops and joins all worker threads
+
+    /**
+     * @brief Method to stop and join all worker threads, dropping the images that are still queued.
+     * onReady isn't called again once it returns
+     * 
+     */
+    void stop(void);
+
+    /**
+     * @brief Method to queue an image to be downloaded and decoded, 
+     * does nothing if the image is already waiting to load
+     * 
+     * @param url The URL of the image
+     * @param maxWidth Images wider than this are shrunk to it on the worker thread, 
+     * 0 to load the image at its full size
+     */
+    void request(const std::string& url, int maxWidth = 0);
+
+    /**
+     * @brief Method to check if an image was requested and hasn't been taken from 
+     * the ready queue yet
+     * 
+     * @param url The URL of the image
+     * @param fullSize If this is about the full size image instead of the thumbnail
+     * @return true if the image is still loading
+     */
+    bool isPending(const std::string& url, bool fullSize = false);
+
+    /**
+     * @brief Method to take one decoded image out of the ready queue,
+     * called from the render thread
+     * 
+     * @param out The image data to move the decoded image into
+     * @return true if an image was taken, false if the queue is empty
+     */
+    bool popReady(RssImageData& out);
+
+    std::function<void(void)> onReady; //Optional function called from a worker thread when an image is put in the ready queue, set before requesting images
+    RssImageCache cache; //Images that were downloaded before, so they load without the network
+
+private:
+
+    /**
+     * @brief Method that every worker thread runs, taking URLs from the job queue 
+     * until the loader is destroyed
+     * 
+     */
+    void workerLoop(void);
+
+    std::mutex queueMutex;         //Mutex for every queue and set below
+    std::condition_variable jobCv; //Wakes a worker thread when a job is added
+    /**
+     * @brief An image waiting to be loaded
+     * 
+     */
+    struct Job
+    {
+        std::string url;
+        int maxWidth = 0; //The width to shrink the image to, 0 for full size
+    };
+
+    /**
+     * @brief Function to get the key of an image in the pending set, so the
+     * thumbnail and full size image of a URL can load at the same time
+     * 
+     */
+    static std::string pendingKey(const std::string& url, bool fullSize) { return fullSize ? "full " + url : url; }
+
+    std::deque<Job> jobs;          //The images waiting to be downloaded
+    std::deque<RssImageData> ready; //Images that are decoded and waiting to be uploaded
+    std::unordered_set<std::string> pending; //The pendingKey of every image that is in the job queue, loading, or in the ready queue
+    bool stopping = false; //Set when the loader is destroyed so workers exit
+
+    std::vector<std::thread> workers; //The worker threads
+};
@@ -56,13 +56,16 @@ void __logtofile(const char* prefix, const char* fName, const char* fmt, ...);
 #include <ctime> 
 #include <iomanip>
 #include <stdarg.h>
+#include <mutex> //Log lines can come from multiple feed loading threads at once
 
 static std::time_t currentTime = std::time(nullptr); //The current time used to print time info to file
 
 FILE* m_logFile = fopen("log.txt", "w"); //The log file object used to print information to
+static std::mutex m_logMutex; //Mutex so that lines from different threads aren't mixed together
 
 void __logtofile(const char* prefix, const char* fName, const char* fmt, ...)
 {
+    std::lock_guard<std::mutex> lock(m_logMutex); //Only one thread can write a line at a time
     currentTime = std::time(nullptr); //Get the current time
     va_list args; //The list of variadic function arguments
     va_start(args, fmt);
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "logger.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+
+#include "cpr/cpr.h"
+
+/**
+ * @brief Function to get the scheme, host and port part of a URL,
+ * used to group connections that can be reused
+ * 
+ * @param url The full URL
+ * @return std::string The lowercase "scheme://host:port" part of the URL
+ */
+std::string hostOf(const std::string& url);
+
+/**
+ * @brief Function to hash a URL into a name that is the same on every platform and run,
+ * used to name cache files
+ * 
+ * @param url The URL to hash
+ * @return std::string The 64 bit FNV-1a hash of the URL as 16 hex digits
+ */
+std::string urlHash(const std::string& url);
+
+/**
+ * @brief Function to read the Retry-After header of a response
+ * 
+ * @param value The value of the Retry-After header, either a number of seconds or an HTTP date
+ * @return long The number of milliseconds to wait, 0 if the value is empty or can't be read
+ */
+long parseRetryAfter(const std::string& value);
+
+/**
+ * @brief Class that decides when requests to a host may start, so that refreshing
+ * many feeds from one host doesn't get us throttled or banned. Every host has a limit
+ * of requests at once and a minimum gap between the start of two requests, and
+ * hosts that answer with Retry-After get no requests until the time they asked for
+ * 
+ */
+class RssHostScheduler
+{
+public:
+
+    /**
+     * @brief Method to get the scheduler shared by every download
+     * 
+     * @return RssHostScheduler& The shared scheduler
+     */
+    static RssHostScheduler& instance(void);
+
+    /**
+     * @brief Method to wait until a request to a host may start, 
+     * every call must be followed by a call to release
+     * 
+     * @param host The host returned from hostOf
+     */
+    void acquire(const std::string& host);
+
+    /**
+     * @brief Method to let the next request to a host start after a request has finished
+     * 
+     * @param host The host returned from hostOf
+     * @param retryAfterMs How long the host asked us to wait before the next request, or 0
+     */
+    void release(const std::string& host, long retryAfterMs = 0);
+
+    size_t maxPerHost = 2;  //The maximum number of requests to one host at the same time
+    long minGapMs = 250;    //The minimum time between the start of two requests to one host
+
+private:
+
+    /**
+     * @brief When requests to one host may start
+     * 
+     */
+    struct HostState
+    {
+        size_t active = 0; //Requests to the host that haven't finished
+        std::chrono::steady_clock::time_point nextStart; //The earliest time the next request may start
+    };
+
+    std::mutex hostMutex; //Mutex for the host states, requests are made from many threads
+    std::condition_variable hostChanged; //Notified when a request finishes or a host's next start time changes
+    std::unordered_map<std::string, HostState> hosts; //The state of every host that was requested
+};
+
+/**
+ * @brief Class that keeps a pool of cpr sessions for every host, so that
+ * feed and image downloads from the same host reuse an open connection
+ * instead of doing a new TCP and TLS handshake for every request
+ * 
+ */
+class RssSessionPool
+{
+public:
+
+    /**
+     * @brief Method to get the session pool shared by every download
+     * 
+     * @return RssSessionPool& The shared session pool
+     */
+    static RssSessionPool& instance(void);
+
+    /**
+     * @brief Method to make a GET request using an idle session for the URL's host,
+     * the session is returned to the pool after the request so its connection stays alive.
+     * Every request offers gzip, deflate, and brotli (if curl was built with it) compression, and
+     * curl decompresses the body before it is returned.
+     * The request waits for the RssHostScheduler, and a 429 or 503 response with a short 
+     * Retry-After is tried once more after waiting
+     * 
+     * @param url The URL to GET
+     * @param headers The extra request headers to send
+     * @param timeoutMs The request timeout in milliseconds
+     * @return cpr::Response The response of the request, errors are in Response::error
+     */
+    cpr::Response get(const std::string& url, const cpr::Header& headers = cpr::Header{}, long timeoutMs = 5000);
+
+    /**
+     * @brief Method to make a GET request that passes the body to a callback as it arrives
+     * instead of keeping it in the response. Waits for the RssHostScheduler like get, and
+     * retries once like get if onRetry is given, because the callback already saw the body of the first response
+     * 
+     * @param url The URL to GET
+     * @param headers The extra request headers to send
+     * @param onData Called with every piece of the decompressed body, returning false cancels the download
+     * @param wireBytes Optional place to put the size of the body as it was received, before decompressing it
+     * @param timeoutMs The request timeout in milliseconds
+     * @param onRetry Called before the request is made again after a short Retry-After, so the caller can 
+     * throw away the body that onData already got. The request is never retried if this is empty
+     * @return cpr::Response The response of the request without the body, errors are in Response::error
+     */
+    cpr::Response download(const std::string& url, const cpr::Header& headers, const cpr::WriteCallback& onData, size_t* wireBytes = NULL, long timeoutMs = 5000, const std::function<void(void)>& onRetry = nullptr);
+
+    size_t maxIdlePerHost = 8; //The maximum number of idle sessions kept open for one host
+    long maxRetryWaitMs = 10000; //Responses that ask us to retry later than this fail instead of waiting
+
+private:
+
+    /**
+     * @brief Method to take an idle session for a host out of the pool, or 
+     * create a new session if there are none
+     * 
+     * @param host The host returned from hostOf
+     * @return std::unique_ptr<cpr::Session> The session to make requests with
+     */
+    std::unique_ptr<cpr::Session> acquire(const std::string& host);
+
+    /**
+     * @brief Method to put a session back into the pool for a host after a request
+     * 
+     * @param host The host returned from hostOf
+     * @param session The session to keep alive
+     */
+    void release(const std::string& host, std::unique_ptr<cpr::Session> session);
+
+    /**
+     * @brief Method to make a GET request for get or download
+     * 
+     * @param url The URL to GET
+     * @param headers The extra request headers to send
+     * @param timeoutMs The request timeout in milliseconds
+     * @param onData The body callback for download, or NULL to keep the body in the response
+     * @param wireBytes Where to put the compressed size of the body, or NULL
+     * @param onRetry Called before retrying a download, or NULL to only retry requests that keep the body
+     * @return cpr::Response The response of the request
+     */
+    cpr::Response request(const std::string& url, const cpr::Header& headers, long timeoutMs, const cpr::WriteCallback* onData, size_t* wireBytes, const std::function<void(void)>* onRetry);
+
+    std::mutex poolMutex; //Mutex for the idle session lists, requests are made from many threads
+    std::unordered_map<std::string, std::vector<std::unique_ptr<cpr::Session>>> idleSessions; //Every idle session by host
+};
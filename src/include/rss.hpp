@@ -9,11 +9,81 @@
 #include <vector>
 #include <exception>
 #include <chrono> //For timestamps since last checked an RSS channel
+#include <future> //For refreshing multiple RSS feeds at once
+#include <atomic>
+#include <memory> //For shared channel list snapshots
+#include <mutex>
+#include <functional>
+#include <thread> //For the background refresh thread
+#include <queue>
+#include <condition_variable>
+#include <unordered_map>
 
 #include "pugixml.hpp"
 #include "cpr/cpr.h"
+#include "net.hpp"
+#include "arena.hpp"
+#include "xmlstream.hpp"
+#include "date.hpp"
 
-#include "glad/glad.h"
+/**
+ * @brief Function to remove any and all HTML tags and comments from a string in one pass,
+ * decoding common HTML entities and unwrapping CDATA sections. A '<' that is never
+ * closed is kept as text
+ * 
+ * @param str The string reference to remove tags from
+ */
+void cleanHTML(std::string& str);
+
+/**
+ * @brief Function to remove HTML from a character buffer in place, the same as the string version
+ * 
+ * @param data The characters to remove tags from
+ * @param size The number of characters
+ * @return size_t The number of characters left at the start of data
+ */
+size_t cleanHTML(char* data, size_t size);
+
+/**
+ * @brief Function to get a temporary file name next to a file that no other write of the
+ * same file uses, even from another thread or process, so that two downloads of one feed
+ * never write to the same temporary file
+ * 
+ * @param path The path of the file that will be replaced
+ * @return std::string The path of the temporary file, ending in ".tmp"
+ */
+std::string uniqueTempPath(const std::string& path);
+
+/**
+ * @brief Function to write a file so that readers only ever see the whole old file 
+ * or the whole new file, by writing a temporary file next to it and renaming it
+ * 
+ * @param path The path of the file to write
+ * @param data The bytes to write
+ * @param size The number of bytes to write
+ * @return true if the file was written
+ */
+bool writeFileAtomic(const std::string& path, const char* data, size_t size);
+
+class RssSnapshot;
+class RssImageCache;
+
+/**
+ * @brief Decoded RGBA image pixels, made on a worker thread so
+ * that only the texture upload has to happen on the render thread
+ * 
+ */
+struct RssImageData
+{
+    std::string url; //The URL the image was downloaded from
+
+    int width = 0;  //Width of the decoded image in pixels
+    int height = 0; //Height of the decoded image in pixels
+    std::vector<unsigned char> pixels; //4 byte RGBA pixels, row by row
+    bool fullSize = true; //False if the image was shrunk to a thumbnail
+
+    std::string error; //Why the image failed to load, empty if it loaded
+};
 
 /**
  * @brief Rss Image class, used to encapsulate all data about an image in
@@ -22,48 +92,42 @@
  */
 struct RssImage
 {
-    bool filled = false; //If the image data is filled in or this is empty
+    bool filled = false; //If the image fields are filled in or this is empty
 
-    std::string title; //Required title of the image
-    std::string url; //Required URL to download image from
+    //All text is stored in the arena of the channel that the image belongs to
+    std::string_view title; //Required title of the image
+    std::string_view url; //Required URL to download image from
 
-    std::string description; //Optional description of image contents
-
-    GLuint txID; //OpenGL texture ID
+    std::string_view description; //Optional description of image contents
 
     int width = 88; //Optional w of image, default is 88 px
     int height = 31; //Option h of image, default is 31 px
-    int ch = 3;
 
     /**
      * @brief Method to construct an RssImage from an XML image 
      * specification
      * 
      * @param xmlNode The <image> </image> pugixml node to get the image data from
+     * @param arena The arena of the channel to store the image text in
      * @return RssImage The constructed RssImage 
      * @throw std::runtime_error if a required attribute is not found/image couldn't be loaded
      */
-    static RssImage fromXML(const pugi::xml_node& xmlNode);
+    static RssImage fromXML(const pugi::xml_node& xmlNode, RssArena& arena);
 
 
     /**
-     * @brief Method to construct an RSS image from an RSS item's <enclosure> child
-     * 
-     * @param xmlNode The <enclosure> child node of the <item> node
-     * @return RssImage when all required fields are met
-     */
-    static RssImage fromXMLEnclosure(const pugi::xml_node& xmlNode); 
-
-
-    /**
-     * @brief Method to load image data from a given url explicitly,
+     * @brief Method to download and decode image data from a given url explicitly,
      * used to give people with slow connections an option to not
-     * download images
+     * download images. Safe to call from any thread, the pixels are uploaded 
+     * to OpenGL later by the GUI. With a cache, a cached image is read from disk without
+     * using the network until it is old enough to check again with its validators
      * 
      * @param t_url The url to download from
+     * @param cache The optional image cache to read from and save the download to
+     * @return RssImageData The decoded RGBA pixels
      * @throw std::runtime_error if the request failed / image failed to load
      */
-    void loadImgFromUrl(const std::string t_url); 
+    static RssImageData loadImgFromUrl(const std::string t_url, RssImageCache* cache = NULL); 
 
     
 };
@@ -76,22 +140,28 @@ struct RssImage
  */
 struct RssItem
 {
-    std::string title; //Required title of the item
-    std::string description; //Required description of the item 
-    std::string link; //Required link to the item contents
-
-    std::string pubDate; //Optional The last publication date of the item
-    std::string author;  //Optional author of this RSS item
+    //All text is stored in the arena of the channel that the item belongs to
+    std::string_view title; //Required title of the item
+    std::string_view description; //Required description of the item 
+    std::string_view link; //Required link to the item contents
+
+    std::string_view pubDate; //Optional The last publication date of the item
+    int64_t published = 0;    //The pubDate read once as seconds since 1970 in UTC, 0 if there is no date or it couldn't be read
+    std::string_view author;  //Optional author of this RSS item
     RssImage enclosure; //Optional media file included in item
 
+    std::string_view guid; //Identifies the item between refreshes, the <guid> of the item or its link if it has none
+    uint64_t contentHash = 0; //Hash of the raw XML fields of the item, changes when the item is edited
+
     /**
      * @brief Method to construct an RSS item from an xml <item> node
      * 
      * @param xmlNode The read only xml node to read all item data into
+     * @param arena The arena of the channel to store the item text in
      * @return RssItem The constructed RSS item object
      * @throw std::runtime_error when a required field is missing
      */
-    static RssItem fromXML(const pugi::xml_node& xmlNode); 
+    static RssItem fromXML(const pugi::xml_node& xmlNode, RssArena& arena); 
 };
 
 /**
@@ -106,33 +176,246 @@ struct RssChannel //One Rss subscribed channel
 
     size_t ttl; //Time to live, number of minutes until a refresh of the feed is needed
     size_t lastChecked = 0; //Not part of the RSS channel, but helpful to record when this channel was downloaded for ttl caching; ms since 1970 this was checked at
+    std::string etag;         //The HTTP ETag validator of the last download, sent back as If-None-Match
+    std::string lastModified; //The HTTP Last-Modified validator of the last download, sent back as If-Modified-Since
+    uint32_t skipHours = 0; //Bit h is set if the feed asks not to be refreshed during hour h UTC, from <skipHours>
+    uint32_t skipDays = 0;  //Bit d is set if the feed asks not to be refreshed on day d of the week, Sunday is 0, from <skipDays>
+    size_t wireBytes = 0;    //Size of the feed body as it was received in the last download, compressed if the server compressed it
+    size_t decodedBytes = 0; //Size of the feed body after decompressing it, both are 0 if the channel wasn't downloaded
 
     RssImage image; //Optional image to go with channel
     std::vector<RssItem> items; //Required list of all attached items 
+    std::vector<uint32_t> byDate; //Indices of items from newest to oldest, items without a date are last in feed order
+    std::shared_ptr<RssArena> arena; //Owns the text of the image and every item, shared by copies of the channel and freed with the last one
 
     /**
-     * @brief Method to construct an Rss Channel from a pugixml node
+     * @brief Method to sort the byDate index, called once after the items of a channel are read
+     * 
+     */
+    void sortByDate(void);
+
+    /**
+     * @brief Method to count the items published since a time, which are the first
+     * items in byDate
+     * 
+     * @param since Seconds since 1970 in UTC
+     * @return size_t The number of items published at or after since
+     */
+    size_t countSince(int64_t since) const;
+
+    /**
+     * @brief Method to construct an Rss Channel from a pugixml node. RSS 2.0 (<rss>), 
+     * Atom (<feed>), and RSS 1.0 (<rdf:RDF>) feeds are read into the same channel, 
+     * Atom entries are read as items
+     * 
+     * Items are matched with the items of the previous channel by guid, items that are unchanged
+     * are copied from the previous channel instead of being parsed again and items that the
+     * feed no longer publishes are kept after the new ones
      * 
      * @param xmlNode The XML node that this RSS feed should be constructed from
      * @param link The link that this RSS feed originated from
+     * @param previous The channel from the last refresh of the same feed, or NULL
      * @return RssChannel object that was constructed from the XML
      * @throw std::runtime_error when xml construction fails
      */
-    static RssChannel fromXML(const pugi::xml_document& xmlDoc, const std::string link); 
+    static RssChannel fromXML(const pugi::xml_document& xmlDoc, const std::string link, const RssChannel* previous = NULL); 
 
     /**
      * @brief Method to download an RSS feed from a URL and 
-     * parse the feed to a channel object
+     * parse the feed to a channel object while it downloads. The downloaded bytes are saved to the
+     * cache file for the URL as they were received. If validators from a previous download 
+     * are given, the request is conditional and a 304 Not Modified response
+     * reuses the cached feed without downloading it again
      * 
      * @param url The URL to load the RSS feed from
+     * @param etag The optional ETag of the last download
+     * @param lastModified The optional Last-Modified date of the last download
+     * @param previous The channel from the last download to merge new items into, or NULL. It is returned
+     * as it is if the feed wasn't modified
+     * @param onPartial Optional function called on the downloading thread with the channel so far
+     * as items arrive, when there is no previous channel to show instead
      * @return RssChannel The constructed RSS channel 
      * @throw std::runtime_error if GET request, XML parsing, or RSS construction fails
      */
-    static RssChannel fromUrl(const std::string url);
+    static RssChannel fromUrl(const std::string url, const std::string etag = "", const std::string lastModified = "", const RssChannel* previous = NULL, 
+                              std::function<void(const RssChannel&)> onPartial = nullptr);
+
+    /**
+     * @brief Method to load an RSS channel from the cached RSS file 
+     * of a URL, streaming the file through RssStreamParser a piece at a time
+     * 
+     * @param link The link that the cached RSS feed originated from
+     * @return RssChannel The constructed RSS channel
+     * @throw std::runtime_error if the cache file is missing or XML parsing fails
+     */
+    static RssChannel fromCache(const std::string link);
+
+    /**
+     * @brief Method to get when the channel should be refreshed next, the ttl after it was
+     * last checked, moved past any hours and days that the feed asks us to skip
+     * 
+     * @param defaultTtl The ttl to use if the channel has none
+     * @return size_t Minutes since 1970 that the channel is due at
+     */
+    size_t nextRefresh(size_t defaultTtl) const;
 
 };
 
 
+/**
+ * @brief Class that builds an RSS channel from its XML while the XML is still arriving,
+ * adding every item to the channel as soon as its closing tag is parsed. Nothing but the
+ * channel itself and the item being read is kept in memory. Reads the same RSS 2.0, Atom, and
+ * RSS 1.0 feeds as RssChannel::fromXML, and merges items with a previous channel the same way
+ * 
+ */
+class RssStreamParser : private RssXmlHandler
+{
+public:
+
+    /**
+     * @brief Construct a parser for one feed
+     * 
+     * @param link The link that the RSS feed originated from
+     * @param previous The channel from the last refresh of the same feed, or NULL. It must stay alive until finish
+     */
+    RssStreamParser(const std::string& link, const RssChannel* previous = NULL);
+
+    /**
+     * @brief Method to parse the next piece of the feed
+     * 
+     * @param data The bytes of the next piece
+     * @param size The number of bytes
+     * @return true if the feed can still be parsed, false if the XML is malformed or isn't UTF-8
+     */
+    bool feed(const char* data, size_t size);
+
+    /**
+     * @brief Method to finish the channel after the whole feed was fed
+     * 
+     * @return RssChannel The constructed RSS channel
+     * @throw std::runtime_error if the XML is incomplete or a required channel element is missing
+     */
+    RssChannel finish(void);
+
+    size_t itemCount(void) const { return channel.items.size(); } //The number of items parsed so far
+    const RssChannel& partial(void) const { return channel; }    //The channel as far as it was parsed, without items from the previous channel
+    const std::string& error(void) const { return xml.error(); } //Why feed returned false
+
+private:
+
+    void startElement(std::string_view name, const RssXmlAttribute* attributes, size_t count) override;
+    void endElement(std::string_view name) override;
+    void text(std::string_view text) override;
+
+    /**
+     * @brief The text of an element that is being read, only the first 
+     * element with a name is read like pugixml's child()
+     * 
+     */
+    struct Field
+    {
+        std::string text;     //The first text of the element, the string is reused for every item
+        bool present = false; //If the element was found
+        bool hasText = false; //If the text was read
+        bool inner = false;   //If all of the text inside of child elements is joined instead, for Atom xhtml text
+
+        void reset(void) { text.clear(); present = false; hasText = false; inner = false; }
+    };
+
+    /**
+     * @brief Method to start reading the text of an element into a field, 
+     * if the field wasn't read yet
+     * 
+     * @param f The field to read into
+     */
+    void startField(Field& f);
+
+    /**
+     * @brief Method to start reading an Atom text construct into a field, joining
+     * the text of child elements if its type is xhtml
+     * 
+     * @param f The field to read into
+     * @param attributes The attributes of the element
+     * @param count The number of attributes
+     */
+    void startAtomText(Field& f, const RssXmlAttribute* attributes, size_t count);
+
+    /**
+     * @brief Method to read an Atom <link> of an entry, which is the entry's 
+     * link or an attachment depending on its rel attribute
+     * 
+     * @param attributes The attributes of the element
+     * @param count The number of attributes
+     */
+    void readAtomLink(const RssXmlAttribute* attributes, size_t count);
+
+    void finishItem(void);  //Method to add the item that was just closed to the channel
+    void finishImage(void); //Method to set the channel image after it was closed
+
+    /**
+     * @brief What the open child element of <channel> is
+     * 
+     */
+    enum Scope
+    {
+        SCOPE_NONE,
+        SCOPE_ITEM,
+        SCOPE_IMAGE,
+        SCOPE_SKIP_HOURS,
+        SCOPE_SKIP_DAYS
+    };
+
+    /**
+     * @brief The format of the feed, from the name of the root element
+     * 
+     */
+    enum Format
+    {
+        FORMAT_NONE,
+        FORMAT_RSS,  //RSS 2.0, <rss><channel>...<item>
+        FORMAT_ATOM, //<feed>...<entry>
+        FORMAT_RDF   //RSS 1.0, <rdf:RDF><channel>...</channel><item>
+    };
+
+    RssXmlStream xml; //The XML tokenizer calling this parser
+    const RssChannel* previous;
+    std::unordered_map<std::string_view, const RssItem*> previousItems; //Items of the previous channel that weren't found yet by guid
+    size_t reused = 0; //Items copied from the previous channel
+    RssChannel channel; //The channel being built
+
+    size_t depth = 0;          //The depth of the innermost open element, the root is 1
+    Format format = FORMAT_NONE;
+    size_t itemDepth = 0;      //The depth of item and image elements for the format
+    bool inChannel = false;    //If the first <channel> is open, or the <feed> for Atom
+    bool sawChannel = false;   //If a <channel> was opened, later ones are ignored
+    bool sawImage = false;     //If the channel <image> was read, later ones are ignored
+    bool sawSkipHours = false;
+    bool sawSkipDays = false;
+    Scope scope = SCOPE_NONE;
+    bool inAuthor = false;     //If an Atom entry's <author> is open
+    Field* field = NULL;       //The field that text goes into
+    size_t fieldDepth = 0;     //The depth of the element that field is reading
+
+    Field channelTitle, channelDescription, channelTtl, channelLogo, channelIcon;
+    Field itemTitle, itemLink, itemDescription, itemAuthor, itemPubDate, itemGuid;
+    Field itemContent, itemUpdated; //Atom entry text used when there is no <summary> or <published>
+    Field imageTitle, imageUrl, imageDescription, imageWidth, imageHeight;
+    Field skipValue; //The <hour> or <day> being read
+
+    bool itemHasEnclosure = false;  //If the item being read has an <enclosure>
+    bool enclosureHasUrl = false;
+    bool enclosureHasType = false;
+    std::string enclosureUrl, enclosureType;
+};
+
+/**
+ * @brief An immutable list of channels, a new list is published every time 
+ * a channel is added, removed, or refreshed so readers never see a list change
+ * 
+ */
+typedef std::vector<std::shared_ptr<const RssChannel>> RssChannelList;
+
 /**
  * @brief Class to manage a collection of RSS channels,
  * recording their ttls, saving the last loaded time to see if we need to
@@ -145,13 +428,39 @@ public:
 
     /**
      * @brief Method to add a channel to the list of subscribed channels, 
-     * downloading from a URL
+     * downloading from a URL. If the link is already subscribed, the channel
+     * is refreshed instead and new items are merged into it
      * 
      * @param link The link to download the RSS feed from
      * @throw the error message if the operation fails
      */
     void addChannel(const std::string link); 
 
+    /**
+     * @brief Method to download a subscribed channel again, merging new items
+     * into it and publishing the refreshed channel in the same place in the list.
+     * A feed from the record that failed to load is downloaded and added to the list instead
+     * 
+     * @param link The link of the subscribed channel
+     * @throw std::runtime_error if the channel isn't subscribed or the download fails
+     */
+    void refreshChannel(const std::string link);
+
+    /**
+     * @brief Method to start a background thread that refreshes every channel when it is 
+     * due, sleeping until the next channel is due. Refreshed channels are published like
+     * any other change to the list
+     * 
+     */
+    void startRefreshing(void);
+
+    /**
+     * @brief Method to stop the background refresh thread, waiting for refreshes
+     * that already started
+     * 
+     */
+    void stopRefreshing(void);
+
     /**
      * @brief Method to remove a channel from the list of subscribed channels,
      * also removing it from the record file
@@ -163,23 +472,164 @@ public:
     RssFeedManager(void);
     ~RssFeedManager();
 
-    std::vector<RssChannel> channels; //List of all subscribed channels
+    /**
+     * @brief Method to get the current list of subscribed channels without locking, 
+     * the returned list and channels never change so it can be read while background
+     * threads publish new lists
+     * 
+     * @return std::shared_ptr<const RssChannelList> The latest published channel list
+     */
+    std::shared_ptr<const RssChannelList> snapshot(void) const;
+
+    std::function<void(void)> onPublish; //Optional function called from any thread after a new channel list is published, set before loading channels
+
+    size_t maxConcurrentRefresh = 8; //The maximum number of RSS feeds that can be downloading at the same time
+    size_t defaultTtl = 60; //Minutes between background refreshes of channels that have no ttl
+    size_t backoffBase = 5;         //Minutes to wait before trying a feed again after its first failure, doubled after every failure
+    size_t maxBackoff = 6 * 60;     //The longest wait between tries of a failing feed before its circuit opens
+    size_t circuitThreshold = 5;    //Failures in a row that open the circuit of a feed
+    size_t circuitOpenDelay = 24 * 60; //Minutes between tries of a feed with an open circuit
 
     /**
      * @brief Method to use subscribed.txt file to load all RSS feeds, either
      * by downloading them if their ttl is not given or lower than last checked,
-     * or using cached RSS files if the feed hasn't refreshed yet
+     * or using the channel snapshot or cached RSS files if the feed hasn't refreshed yet.
+     * Up to maxConcurrentRefresh feeds are loaded at once, and the results are
+     * added to the channels list in the same order as the record file
      * 
      */
     void loadChannelsFromRecord(void);
 private:
 
+    /**
+     * @brief One entry of the record file, read before any channels are loaded
+     * so that they can be loaded in parallel
+     * 
+     */
+    struct RecordEntry
+    {
+        std::string title; //Title read from the record
+        std::string url;   //URL of the RSS feed
+        size_t ttl;        //Time to live of the RSS feed
+        size_t lastUpdate; //The last updated time in minutes
+        std::string etag;         //ETag of the last download
+        std::string lastModified; //Last-Modified date of the last download
+        size_t failures = 0; //Failed downloads in a row
+        size_t retryAt = 0;  //Minutes since 1970 before which the feed shouldn't be downloaded
+    };
+
+    /**
+     * @brief How a feed has been failing, kept for channels and for feeds that never loaded
+     * 
+     */
+    struct FeedHealth
+    {
+        size_t failures = 0; //Failed downloads in a row
+        size_t retryAt = 0;  //Minutes since 1970 before which the feed shouldn't be downloaded
+    };
+
+    /**
+     * @brief Method to count a failed download of a feed and back off from it, waiting
+     * exponentially longer with jitter after every failure until the circuit of the feed opens
+     * 
+     * @param link The URL of the feed
+     * @return size_t Minutes since 1970 when the feed may be tried again
+     */
+    size_t recordFailure(const std::string& link);
+
+    /**
+     * @brief Method to reset the failures of a feed after it was downloaded
+     * 
+     * @param link The URL of the feed
+     */
+    void recordSuccess(const std::string& link);
+
+    /**
+     * @brief Method to get when a feed may be downloaded again
+     * 
+     * @param link The URL of the feed
+     * @return size_t Minutes since 1970 when the feed may be tried again, 0 if it isn't failing
+     */
+    size_t retryAtOf(const std::string& link);
+
+    /**
+     * @brief Method to load one channel from a record entry, either from the 
+     * cache file or from the URL if the ttl has passed or the cache is bad
+     * 
+     * @param entry The record entry to load the channel for
+     * @param snapshot The channel snapshot to load channels from before trying the cache file, or NULL
+     * @param out The channel object to load into
+     * @return true if the channel was loaded, false if every attempt failed
+     */
+    bool loadRecordEntry(const RecordEntry& entry, const RssSnapshot* snapshot, RssChannel& out);
+
+    /**
+     * @brief Method to download a feed that failed to load from the record, adding it to 
+     * the channel list if it works. Called by the refresh thread when the feed's backoff is over
+     * 
+     * @param link The URL of the feed
+     * @throw std::runtime_error if the feed isn't an unloaded entry or the download failed
+     */
+    void loadUnloadedEntry(const std::string& link);
+
+    /**
+     * @brief Method to make a new channel list visible to readers and schedule the refreshes
+     * of its channels and of the unloaded entries, called with publishMutex locked
+     * 
+     * @param list The new channel list
+     */
+    void publish(std::shared_ptr<const RssChannelList> list);
+
+    /**
+     * @brief Method run by the background refresh thread, refreshing 
+     * due channels until stopRefreshing is called
+     * 
+     */
+    void refreshLoop(void);
+
+    /**
+     * @brief A time that a channel is due to be refreshed, ordered so the
+     * refresh queue gives the earliest one first
+     * 
+     */
+    struct DueRefresh
+    {
+        size_t due;       //Minutes since 1970 that the channel is due at
+        std::string link; //The link of the channel
+
+        bool operator>(const DueRefresh& other) const { return due > other.due; }
+    };
+
+    /**
+     * @brief When a subscribed channel is scheduled to be refreshed
+     * 
+     */
+    struct RefreshTimes
+    {
+        size_t channelDue;   //The time from RssChannel::nextRefresh when the channel was published
+        size_t scheduledDue; //The time it is actually scheduled for, later if a refresh failed
+    };
+
+    std::shared_ptr<const RssChannelList> channels = std::make_shared<const RssChannelList>(); //The published list of all subscribed channels, only accessed with atomic loads and stores
+    std::mutex publishMutex; //Mutex so that only one thread at a time makes a new channel list from the current one
+
     std::fstream recordFile;        //Record of subscribed channels, their ttls and last checked times
+    std::vector<RecordEntry> unloadedEntries; //Record entries that failed to load, written back so they aren't forgotten, locked with publishMutex
+
+    std::unordered_map<std::string, FeedHealth> feedHealth; //Feeds that are failing by link
+    std::mutex healthMutex; //Mutex for feedHealth, locked last
+
+    std::priority_queue<DueRefresh, std::vector<DueRefresh>, std::greater<DueRefresh>> refreshQueue; //Min heap of due times, entries that don't match refreshTimes are old and skipped
+    std::unordered_map<std::string, RefreshTimes> refreshTimes; //The refresh times of every subscribed channel by link
+    std::mutex refreshMutex; //Mutex for the refresh queue and times, locked after publishMutex when both are needed
+    std::condition_variable refreshWake; //Wakes the refresh thread when the earliest due time changes or it should stop
+    std::thread refreshThread; //The background refresh thread, if it was started
+    bool refreshRunning = false; //If the refresh thread should keep running
 
     /**
      * @brief Method called in the destructor for RssFeedManager class
      * writes all last checked dates to the record file, plus all ttls, titles,
-     * and urls of subscribed RSS feeds
+     * and urls of subscribed RSS feeds, and writes the channel snapshot
      * 
      */
     void writeRecord(void);    //Function to write the last downloaded date to the record file
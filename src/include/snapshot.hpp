@@ -0,0 +1,190 @@
+#pragma once
+
+#include "rss.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+
+/**
+ * @brief Class that maps a whole file into memory read only, 
+ * so it can be read without copying it into a buffer first
+ * 
+ */
+class RssMappedFile
+{
+public:
+
+    /**
+     * @brief Map a file into memory, check valid() to see if it worked
+     * 
+     * @param path The path of the file to map
+     */
+    RssMappedFile(const std::string& path);
+    ~RssMappedFile(); //Unmaps the file
+
+    RssMappedFile(const RssMappedFile&) = delete;
+    RssMappedFile& operator=(const RssMappedFile&) = delete;
+
+    bool valid(void) const { return data != NULL; } //If the file was mapped
+
+    const char* data = NULL; //The first byte of the mapped file
+    size_t size = 0;         //The size of the mapped file in bytes
+
+private:
+    #ifdef _WIN32
+    void* fileHandle = NULL;    //The Windows file handle
+    void* mappingHandle = NULL; //The Windows file mapping handle
+    #endif
+};
+
+/**
+ * @brief Class to write every channel to one binary file and map it back in on startup,
+ * the file holds fixed size channel and item records that point into one string table, 
+ * so loading a channel needs no parsing at all
+ * 
+ */
+class RssSnapshot
+{
+public:
+
+    /**
+     * @brief Method to write a snapshot of channels to a file, replacing it in one step
+     * 
+     * @param path The path of the snapshot file
+     * @param channels The channels to write
+     * @return true if the snapshot was written
+     */
+    static bool write(const std::string& path, const RssChannelList& channels);
+
+    /**
+     * @brief Method to map a snapshot file and check that it is a snapshot this version can read
+     * 
+     * @param path The path of the snapshot file
+     * @return true if the snapshot can be read
+     */
+    bool open(const std::string& path);
+
+    /**
+     * @brief Method to find a channel in the snapshot by the URL it was downloaded from,
+     * the text of the channel's items is not copied, the channel arena keeps the file mapped instead
+     * 
+     * @param link The URL of the channel
+     * @param lastChecked The lastChecked time the channel needs, so channels older than the record aren't used
+     * @param out The channel to fill in
+     * @return true if the channel was found and read
+     */
+    bool find(const std::string& link, size_t lastChecked, RssChannel& out) const;
+
+    /**
+     * @brief A string in the string table of the snapshot file
+     * 
+     */
+    struct StrRef
+    {
+        uint32_t offset; //Offset from the start of the string table
+        uint32_t length; //Length in bytes, not counting the null character after every string
+    };
+
+    /**
+     * @brief Fixed size image fields, part of channel and item records
+     * 
+     */
+    struct ImageRecord
+    {
+        StrRef title;
+        StrRef url;
+        StrRef description;
+        int32_t width;
+        int32_t height;
+        uint32_t filled;
+        uint32_t pad; //Keeps records a multiple of 8 bytes
+    };
+
+    /**
+     * @brief Fixed size record of one channel in the snapshot file
+     * 
+     */
+    struct ChannelRecord
+    {
+        StrRef title;
+        StrRef description;
+        StrRef link;
+        StrRef etag;
+        StrRef lastModified;
+        ImageRecord image;
+        uint64_t ttl;
+        uint64_t lastChecked;
+        uint32_t skipHours;
+        uint32_t skipDays;
+        uint64_t firstItem; //Index of the channel's first item in the item records
+        uint64_t itemCount;
+    };
+
+    /**
+     * @brief Fixed size record of one item in the snapshot file
+     * 
+     */
+    struct ItemRecord
+    {
+        StrRef title;
+        StrRef description;
+        StrRef link;
+        StrRef pubDate;
+        StrRef author;
+        StrRef guid;
+        ImageRecord enclosure;
+        uint64_t contentHash;
+        int64_t published;
+    };
+
+    /**
+     * @brief The header at the start of the snapshot file
+     * 
+     */
+    struct Header
+    {
+        char magic[8];         //"GNSNAP" followed by two zero bytes
+        uint32_t version;      //SNAPSHOT_VERSION of the program that wrote it
+        uint32_t byteOrder;    //0x01020304 written in the byte order of the program that wrote it
+        uint64_t channelCount; 
+        uint64_t itemCount;
+        uint64_t stringBytes;  //Size of the string table
+        uint64_t channelOffset; //Offset of the channel records from the start of the file
+        uint64_t itemOffset;    //Offset of the item records
+        uint64_t stringOffset;  //Offset of the string table
+    };
+
+private:
+
+    /**
+     * @brief Method to get a string from the string table
+     * 
+     * @param ref The string to get
+     * @return std::string The string, empty if the reference is outside of the string table
+     */
+    std::string str(const StrRef& ref) const;
+
+    /**
+     * @brief Method to get a string from the string table without copying it
+     * 
+     * @param ref The string to get
+     * @return std::string_view A null terminated view into the mapped file, empty if the reference is bad
+     */
+    std::string_view view(const StrRef& ref) const;
+
+    /**
+     * @brief Method to read the image fields of a record, the text of the image
+     * points into the mapped file
+     * 
+     * @param rec The image fields
+     * @return RssImage The image
+     */
+    RssImage image(const ImageRecord& rec) const;
+
+    std::shared_ptr<RssMappedFile> file; //The mapped snapshot file, kept alive by the arena of every channel read from it
+    const Header* header = NULL;
+    const ChannelRecord* channelRecs = NULL;
+    const ItemRecord* itemRecs = NULL;
+    const char* strings = NULL;
+    std::unordered_map<std::string, size_t> byLink; //Index of every channel record by link
+};
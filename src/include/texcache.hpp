@@ -0,0 +1,143 @@
+#pragma once
+
+#include "rss.hpp"
+#include "glad/glad.h"
+
+#include <unordered_map>
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+/**
+ * @brief An image that was uploaded to OpenGL and can be drawn with Dear ImGui
+ *
+ */
+struct RssTexture
+{
+    GLuint txID; //OpenGL texture ID
+    int width;   //Width of the image in pixels
+    int height;  //Height of the image in pixels
+
+    float u0 = 0.f, v0 = 0.f; //Texture coordinates of the top left corner of the image, not 0 if the image is in an atlas page
+    float u1 = 1.f, v1 = 1.f; //Texture coordinates of the bottom right corner of the image
+};
+
+/**
+ * @brief Class that owns the OpenGL textures of item images by URL. It remembers the bytes of
+ * every texture and the last frame that it was drawn on, and when the textures use more than
+ * the budget the ones that were drawn longest ago are deleted. Small images are packed together
+ * into shared atlas pages so that Dear ImGui can draw a list of them without switching textures.
+ * A page counts against the budget with its whole size and is evicted as a whole, when none of its images were drawn for the longest
+ * Must only be used on the thread that owns the OpenGL context
+ *
+ */
+class RssTextureCache
+{
+public:
+    static constexpr int ATLAS_PAGE_SIZE = 1024; //The width and height of every atlas page in pixels, a page is 4 MiB so even a small budget holds a few
+    static constexpr size_t ATLAS_PAGE_BYTES = (size_t)ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE * 4; //The video memory of one atlas page
+
+    int atlasMaxWidth = 512; //Images this wide or narrower are packed into atlas pages, set to the thumbnail width so every thumbnail shares pages
+
+    size_t budgetBytes = 128 * 1024 * 1024; //The most video memory that the textures can use, only textures that are still being drawn can go over it
+
+    /**
+     * @brief Function to upload a decoded image to OpenGL
+     *
+     * @param img The decoded image
+     * @return RssTexture The uploaded texture
+     */
+    static RssTexture upload(const RssImageData& img);
+
+    RssTextureCache(void);
+    ~RssTextureCache(); //Doesn't delete any textures, clear() must be called while the OpenGL context exists
+
+    /**
+     * @brief Method to find the texture of an image that is about to be drawn,
+     * marking it as drawn this frame
+     *
+     * @param url The URL of the image
+     * @return const RssTexture* The texture, or NULL if the image isn't uploaded or was evicted
+     */
+    const RssTexture* draw(const std::string& url);
+
+    /**
+     * @brief Method to check if an image is uploaded without marking it as drawn
+     *
+     * @param url The URL of the image
+     * @return true if the image has a texture
+     */
+    bool contains(const std::string& url) const { return textures.count(url) != 0; }
+
+    /**
+     * @brief Method to upload an image and take ownership of its texture, copying
+     * it into an atlas page if it is small enough. Does nothing if the image is already uploaded
+     *
+     * @param url The URL of the image
+     * @param img The decoded image
+     */
+    void insert(const std::string& url, const RssImageData& img);
+
+    /**
+     * @brief Method to delete the texture of an image if it is uploaded. The packer can't 
+     * reuse the space of one image, so an atlas page is only deleted when every image in it is released
+     *
+     * @param url The URL of the image
+     */
+    void release(const std::string& url);
+
+    /**
+     * @brief Method to delete every texture, must be called before the OpenGL context is destroyed
+     *
+     */
+    void clear(void);
+
+    /**
+     * @brief Method to start a new frame, then evict the textures that were drawn longest ago
+     * until the textures fit in the budget. Textures drawn in the last frame are never evicted
+     * so that images on screen aren't reloaded every frame
+     *
+     */
+    void nextFrame(void);
+
+    size_t usedBytes(void) const { return totalBytes; } //The video memory that every texture and atlas page uses
+
+private:
+
+    struct AtlasPage; //A texture that many small images are packed into, defined with the rectangle packer
+
+    /**
+     * @brief One uploaded image
+     *
+     */
+    struct Entry
+    {
+        RssTexture texture;
+        size_t bytes;       //The video memory the image's own texture uses, 0 for images in an atlas page which is counted instead
+        uint64_t lastDrawn; //The frame that the texture was last drawn on
+        AtlasPage* page;    //The atlas page that the image is in, NULL if it has its own texture
+    };
+
+    std::unordered_map<std::string, Entry> textures; //Every uploaded image by URL
+    std::vector<std::unique_ptr<AtlasPage>> pages;   //Every atlas page with at least one image in it
+
+    /**
+     * @brief Method to copy a small image into the first atlas page with room for it,
+     * adding a new page if none has room
+     *
+     * @param url The URL of the image
+     * @param img The decoded image
+     * @param entry The entry to set the texture and page of
+     */
+    void insertIntoAtlas(const std::string& url, const RssImageData& img, Entry& entry);
+
+    size_t totalBytes = 0; //The bytes of every texture and atlas page added up
+    uint64_t frame = 0;    //The number of the frame being drawn
+
+    /**
+     * @brief Method to delete the textures and whole atlas pages that were drawn longest ago until the rest fit in the budget
+     *
+     */
+    void evict(void);
+};
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Function to write a unicode code point as UTF-8
+ *
+ * @param codePoint The code point to encode
+ * @param out Where to write the 1 to 4 encoded bytes
+ * @return size_t The number of bytes written
+ */
+size_t encodeUTF8(unsigned long codePoint, char* out);
+
+/**
+ * @brief One attribute of an XML start tag, with entities already decoded
+ *
+ */
+struct RssXmlAttribute
+{
+    std::string_view name;
+    std::string_view value;
+};
+
+/**
+ * @brief Interface that receives the parts of an XML document as RssXmlStream finds them,
+ * every view is only valid until the method returns
+ *
+ */
+class RssXmlHandler
+{
+public:
+    virtual ~RssXmlHandler() {}
+
+    /**
+     * @brief Called for every start tag, and for empty element tags before endElement
+     *
+     * @param name The name of the element, including any namespace prefix
+     * @param attributes The attributes of the element
+     * @param count The number of attributes
+     */
+    virtual void startElement(std::string_view name, const RssXmlAttribute* attributes, size_t count) = 0;
+
+    /**
+     * @brief Called for every end tag
+     *
+     * @param name The name of the element
+     */
+    virtual void endElement(std::string_view name) = 0;
+
+    /**
+     * @brief Called for every run of text between tags and every CDATA section inside of the root element.
+     * Runs of text that are only whitespace are skipped, like pugixml does
+     *
+     * @param text The decoded text
+     */
+    virtual void text(std::string_view text) = 0;
+};
+
+/**
+ * @brief Class that parses an XML document as it arrives in pieces, calling a handler
+ * for every tag and text run that is complete instead of building a DOM. Only the
+ * piece of the document that hasn't been parsed yet is kept in memory, which is at most
+ * one tag or text run. Decodes the same entities as pugixml, and only reads UTF-8 documents
+ *
+ */
+class RssXmlStream
+{
+public:
+
+    /**
+     * @brief Construct a new XML stream
+     *
+     * @param handler The handler to call for the parts of the document
+     */
+    RssXmlStream(RssXmlHandler& handler);
+
+    /**
+     * @brief Method to parse the next piece of the document
+     *
+     * @param data The bytes of the next piece
+     * @param size The number of bytes
+     * @return true if the document is still well formed, false after any error
+     */
+    bool feed(const char* data, size_t size);
+
+    /**
+     * @brief Method to check that the whole document was parsed after the last piece was fed
+     *
+     * @return true if every element was closed and nothing is left over
+     */
+    bool finish(void);
+
+    const std::string& error(void) const { return errorMessage; } //Why the document failed to parse
+
+private:
+
+    /**
+     * @brief Method to parse as much of a buffer as is complete
+     *
+     * @param data The buffer
+     * @param size The size of the buffer
+     * @return size_t The number of bytes parsed, the rest must be parsed again with more data after it
+     */
+    size_t parse(const char* data, size_t size);
+
+    /**
+     * @brief Method to parse a start tag or empty element tag
+     *
+     * @param tag The characters between the '<' and the '>'
+     * @param size The number of characters
+     */
+    void parseStartTag(const char* tag, size_t size);
+
+    /**
+     * @brief Method to check the encoding in the XML declaration
+     *
+     * @param decl The characters between the "<?" and the "?>"
+     * @param size The number of characters
+     */
+    void checkDeclaration(const char* decl, size_t size);
+
+    /**
+     * @brief Method to decode entities and line endings of text and pass it to the handler
+     *
+     * @param str The raw text
+     * @param size The length of the raw text
+     * @param cdata If the text is a CDATA section, which has no entities and is never skipped
+     */
+    void emitText(const char* str, size_t size, bool cdata);
+
+    /**
+     * @brief Method to decode text onto the end of a string
+     *
+     * @param str The raw text
+     * @param size The length of the raw text
+     * @param out The string to append to
+     * @param attribute If the text is an attribute value, where whitespace characters become spaces
+     */
+    void decode(const char* str, size_t size, std::string& out, bool attribute);
+
+    /**
+     * @brief Method to stop parsing because of an error
+     *
+     * @param message What is wrong with the document
+     */
+    void fail(const std::string& message);
+
+    RssXmlHandler& handler;
+    std::string buffer;  //The end of the last piece that couldn't be parsed yet
+    size_t resumeAt = 0; //How far into the unfinished node at the start of buffer its end was already looked for, so long nodes are only searched once
+    std::string decoded; //Reused buffer for text with entities
+    std::string attributeValues; //Reused buffer for decoded attribute values
+    std::vector<RssXmlAttribute> attributes; //Reused list of the attributes of a start tag
+    std::string openNames;          //The names of every open element, one after another
+    std::vector<size_t> openStarts; //Where each open element's name starts in openNames
+    bool started = false;   //If any of the document was parsed, to skip a byte order mark
+    bool sawRoot = false;   //If the root element was opened
+    bool failed = false;
+    std::string errorMessage;
+};
@@ -0,0 +1,2 @@
+#define LOG_IMPL
+#include "include/logger.hpp"
@@ -0,0 +1,187 @@
+#include "include/net.hpp"
+#include "include/date.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+#include <curl/curl.h> //For compression and transfer sizes that cpr doesn't expose
+
+std::string hostOf(const std::string& url)
+{
+    size_t hostStart = url.find("://"); //Find where the scheme ends
+    hostStart = (hostStart == std::string::npos) ? 0 : hostStart + 3;
+
+    size_t hostEnd = url.find_first_of("/?#", hostStart); //The host ends at the path, query, or fragment
+    if(hostEnd == std::string::npos) hostEnd = url.size();
+
+    std::string host = url.substr(0, hostEnd);
+    std::transform(host.begin(), host.end(), host.begin(), [](unsigned char c) { return (char)std::tolower(c); }); //Host names are case insensitive
+    return host;
+}
+
+std::string urlHash(const std::string& url)
+{
+    uint64_t hash = 14695981039346656037ULL; //FNV-1a offset basis
+    for(unsigned char c : url)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL; //FNV-1a prime
+    }
+
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+    return hex;
+}
+long parseRetryAfter(const std::string& value)
+{
+    if(value.empty()) return 0;
+
+    if(std::isdigit((unsigned char)value[0])) //A number of seconds to wait
+    {
+        return std::strtol(value.c_str(), NULL, 10) * 1000;
+    }
+
+    int64_t until = parseFeedDate(value); //An HTTP date like "Wed, 21 Oct 2015 07:28:00 GMT" is an RFC 822 date, read without the global locale
+    if(until == 0) return 0;
+
+    double seconds = std::difftime((time_t)until, std::time(NULL));
+    return (seconds > 0) ? (long)(seconds * 1000) : 0;
+}
+
+RssHostScheduler& RssHostScheduler::instance(void)
+{
+    static RssHostScheduler scheduler; //Created the first time a request is made
+    return scheduler;
+}
+
+void RssHostScheduler::acquire(const std::string& host)
+{
+    std::unique_lock<std::mutex> lock(hostMutex);
+    HostState& state = hosts[host]; //References into the map stay valid when other hosts are added
+
+    while(true)
+    {
+        if(state.active < maxPerHost) 
+        {
+            auto now = std::chrono::steady_clock::now();
+            if(now >= state.nextStart) break; //There is a free slot and the gap since the last request has passed
+
+            hostChanged.wait_until(lock, state.nextStart);
+        }
+        else
+        {
+            hostChanged.wait(lock); //Wait for a request to the host to finish
+        }
+    }
+
+    state.active++;
+    state.nextStart = std::chrono::steady_clock::now() + std::chrono::milliseconds(minGapMs);
+}
+
+void RssHostScheduler::release(const std::string& host, long retryAfterMs)
+{
+    {
+        std::lock_guard<std::mutex> lock(hostMutex);
+        HostState& state = hosts[host];
+        state.active--;
+        if(retryAfterMs > 0) //Hold every request to the host back until the time it asked for
+        {
+            state.nextStart = std::max(state.nextStart, std::chrono::steady_clock::now() + std::chrono::milliseconds(retryAfterMs));
+        }
+    }
+    hostChanged.notify_all();
+}
+
+RssSessionPool& RssSessionPool::instance(void)
+{
+    static RssSessionPool pool; //Created the first time a request is made
+    return pool;
+}
+
+std::unique_ptr<cpr::Session> RssSessionPool::acquire(const std::string& host)
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    std::vector<std::unique_ptr<cpr::Session>>& idle = idleSessions[host];
+    if(idle.empty()) //No idle connection to this host, so make a new one
+    {
+        std::unique_ptr<cpr::Session> session(new cpr::Session());
+        //An empty encoding offers every compression that curl supports, curl decompresses the body as it arrives
+        curl_easy_setopt(session->GetCurlHolder()->handle, CURLOPT_ACCEPT_ENCODING, "");
+        return session;
+    }
+
+    std::unique_ptr<cpr::Session> session = std::move(idle.back()); //Take the most recently used session, it is the most likely to still be connected
+    idle.pop_back();
+    return session;
+}
+
+void RssSessionPool::release(const std::string& host, std::unique_ptr<cpr::Session> session)
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    std::vector<std::unique_ptr<cpr::Session>>& idle = idleSessions[host];
+    if(idle.size() < maxIdlePerHost) idle.push_back(std::move(session)); //Close the connection if too many are already open
+}
+
+cpr::Response RssSessionPool::get(const std::string& url, const cpr::Header& headers, long timeoutMs)
+{
+    return request(url, headers, timeoutMs, NULL, NULL, NULL);
+}
+
+cpr::Response RssSessionPool::download(const std::string& url, const cpr::Header& headers, const cpr::WriteCallback& onData, size_t* wireBytes, long timeoutMs, const std::function<void(void)>& onRetry)
+{
+    return request(url, headers, timeoutMs, &onData, wireBytes, onRetry ? &onRetry : NULL);
+}
+
+cpr::Response RssSessionPool::request(const std::string& url, const cpr::Header& headers, long timeoutMs, const cpr::WriteCallback* onData, size_t* wireBytes, const std::function<void(void)>* onRetry)
+{
+    std::string host = hostOf(url);
+    RssHostScheduler& scheduler = RssHostScheduler::instance();
+    //Sessions that downloaded with a callback keep it set, so they are pooled apart from the ones that keep the body
+    std::string poolKey = (onData != NULL) ? host + " download" : host;
+
+    for(int attempt = 0; ; ++attempt)
+    {
+        scheduler.acquire(host); //Wait for our turn to make a request to the host
+        std::unique_ptr<cpr::Session> session = acquire(poolKey);
+
+        //Set every option again, sessions keep the options from their last request
+        session->SetUrl(cpr::Url{url});
+        session->SetHeader(headers);
+        session->SetTimeout(cpr::Timeout{timeoutMs});
+
+        cpr::Response resp = (onData != NULL) ? session->Download(*onData) : session->Get();
+
+        if(wireBytes != NULL) //Curl counts the body before it is decompressed
+        {
+            curl_off_t received = 0;
+            curl_easy_getinfo(session->GetCurlHolder()->handle, CURLINFO_SIZE_DOWNLOAD_T, &received);
+            *wireBytes = (size_t)received;
+        }
+
+        if(resp.error.code == cpr::ErrorCode::OK) //Only reuse sessions that are still in a good state
+        {
+            release(poolKey, std::move(session));
+        }
+
+        long retryAfterMs = 0; //How long the host wants us to leave it alone
+        if(resp.status_code == 429 || resp.status_code == 503)
+        {
+            auto retryAfter = resp.header.find("Retry-After");
+            if(retryAfter != resp.header.end()) retryAfterMs = parseRetryAfter(retryAfter->second);
+        }
+        scheduler.release(host, retryAfterMs);
+
+        bool canRetry = onData == NULL || onRetry != NULL; //A download can only be retried if the caller can throw away the body it already got
+        if(canRetry && retryAfterMs > 0 && attempt == 0 && retryAfterMs <= maxRetryWaitMs) //Try once more when the host asks for a short wait, the scheduler makes us wait for it
+        {
+            logW("Host %s returned %ld for %s, retrying after %ld ms", host.c_str(), resp.status_code, url.c_str(), retryAfterMs);
+            if(onRetry != NULL) (*onRetry)();
+            continue;
+        }
+        return resp;
+    }
+}
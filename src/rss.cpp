@@ -1,6 +1,15 @@
 #include "include/rss.hpp"
+#include "include/snapshot.hpp"
+#include "include/imgload.hpp"
 
+#define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include <cctype> //For isalpha when looking for HTML tags
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <random> //For jittering backoff delays
+#include <filesystem> //For replacing cache files in one step
 
 /**
  * @brief Function to require an XML node to exist and return its value
@@ -48,276 +57,1734 @@ void cleanWhiteSpace(std::string& str)
 }
 
 /**
- * @brief Function to remove any and all HTML tags from a string
+ * @brief Function to decode one HTML entity like &amp; or &#8217; 
  * 
- * @param str The string reference to remove tags from
+ * @param str The string containing the entity
+ * @param size The length of the string
+ * @param pos The position of the '&' that starts the entity, moved past the entity if it was decoded
+ * @param out Where to write the decoded bytes, the decoded text is never longer than the entity
+ * @return size_t The number of bytes written, or 0 if this isn't an entity that we know
  */
+static size_t decodeEntity(const char* str, size_t size, size_t& pos, char* out)
+{
+    const char* name = str + pos + 1; //The entity name without the '&'
+    const char* semicolon = (const char*)memchr(name, ';', std::min<size_t>(size - pos - 1, 10)); //Every entity we decode is short, so only look a few characters ahead
+    if(semicolon == NULL) return 0; //This is just an '&'
+    size_t len = semicolon - name;
+
+    if(len > 1 && name[0] == '#') //Numeric character reference
+    {
+        char* badChar;
+        unsigned long codePoint = (name[1] == 'x' || name[1] == 'X') ? std::strtoul(name + 2, &badChar, 16) : std::strtoul(name + 1, &badChar, 10);
+        if(badChar != semicolon || codePoint == 0 || codePoint > 0x10FFFF) return 0; //Not a valid number
+        pos += len + 2; //Skip past the ';'
+        return encodeUTF8(codePoint, out);
+    }
+
+    char value; //The character the named entity stands for
+    if(len == 3 && memcmp(name, "amp", 3) == 0) value = '&';
+    else if(len == 2 && memcmp(name, "lt", 2) == 0) value = '<';
+    else if(len == 2 && memcmp(name, "gt", 2) == 0) value = '>';
+    else if(len == 4 && memcmp(name, "quot", 4) == 0) value = '\"';
+    else if(len == 4 && memcmp(name, "apos", 4) == 0) value = '\'';
+    else if(len == 4 && memcmp(name, "nbsp", 4) == 0) value = ' ';
+    else return 0; //Not an entity that we know
+
+    out[0] = value;
+    pos += len + 2; //Skip past the ';'
+    return 1;
+}
+
 void cleanHTML(std::string& str)
 {
-    while (str.find("<") != std::string::npos)
+    str.resize(cleanHTML(&str[0], str.size()));
+}
+
+size_t cleanHTML(char* data, size_t size)
+{
+    size_t in = 0;  //The position being read from
+    size_t out = 0; //The position being written to, never past the read position
+    size_t nextClose = 0; //The position of the next '>' after the read position, kept so the string is only searched once
+    size_t nextCommentEnd = 0; //The position of the next "-->" after the read position, kept for the same reason
+    bool inCData = false; //If we are inside of a CDATA section, so the next "]]>" ends it
+    std::string_view str(data, size);
+
+    while(in < size)
+    {
+        //Move all plain text up to the next character that could start markup at once
+        size_t run = in;
+        while(run < size && data[run] != '<' && data[run] != '&' && data[run] != ']') run++;
+        if(run != in)
+        {
+            if(out != in) memmove(data + out, data + in, run - in);
+            out += run - in;
+            in = run;
+            continue;
+        }
+
+        char c = data[in];
+        if(c == '<' && in + 1 < size)
+        {
+            char next = data[in + 1];
+            if(next == '!' && size - in >= 9 && memcmp(data + in, "<![CDATA[", 9) == 0) //Drop the CDATA markers but keep cleaning the text inside, it is usually more HTML
+            {
+                inCData = true;
+                in += 9;
+                continue;
+            }
+            else if(next == '!' && size - in >= 4 && memcmp(data + in, "<!--", 4) == 0) //Skip comments, which can contain '>'
+            {
+                if(nextCommentEnd != std::string::npos && nextCommentEnd < in + 4) //Only search again once we've read past the last "-->"
+                {
+                    nextCommentEnd = str.find("-->", in + 4);
+                }
+                if(nextCommentEnd != std::string::npos)
+                {
+                    in = nextCommentEnd + 3;
+                    continue;
+                }
+            }
+            else if(isalpha((unsigned char)next) || next == '/' || next == '!' || next == '?') //Only treat this as a tag if it looks like one, so "a < b" stays
+            {
+                if(nextClose != std::string::npos && nextClose <= in) //Only search again once we've read past the last '>'
+                {
+                    const char* close = (const char*)memchr(data + in + 1, '>', size - in - 1);
+                    nextClose = (close == NULL) ? std::string::npos : (size_t)(close - data);
+                }
+                if(nextClose != std::string::npos)
+                {
+                    in = nextClose + 1;
+                    continue;
+                }
+            }
+        }
+        else if(c == ']' && inCData && size - in >= 3 && memcmp(data + in, "]]>", 3) == 0) //End of a CDATA section
+        {
+            inCData = false;
+            in += 3;
+            continue;
+        }
+        else if(c == '&')
+        {
+            size_t written = decodeEntity(data, size, in, data + out); //Safe to write in place, decoded text is shorter than the entity
+            if(written != 0)
+            {
+                out += written;
+                continue;
+            }
+        }
+
+        data[out++] = c;
+        in++;
+    }
+
+    return out;
+}
+
+/**
+ * @brief Function to get the path of the cached RSS file for a feed
+ * 
+ * @param url The URL the feed is downloaded from
+ * @return std::string The path to the cached RSS file
+ */
+std::string cachePathFor(const std::string& url)
+{
+    return "cached/" + urlHash(url) + ".rss"; //Name the file by URL, titles can have characters that aren't allowed in file names
+}
+
+std::string uniqueTempPath(const std::string& path)
+{
+    static const unsigned long long processToken = std::random_device{}(); //Tells apart programs writing the same cache
+    static std::atomic<unsigned long long> counter(0); //Tells apart writes from this program
+
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%llx-%llu.tmp", processToken, counter++);
+    return path + suffix;
+}
+
+bool writeFileAtomic(const std::string& path, const char* data, size_t size)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec); //Make sure the cache folder exists
+
+    std::string tmpPath = uniqueTempPath(path); //Another thread may be writing the same file
+    FILE* tmp = fopen(tmpPath.c_str(), "wb");
+    if(tmp == NULL) return false;
+
+    bool written = fwrite(data, 1, size, tmp) == size;
+    written = (fclose(tmp) == 0) && written;
+    if(written) std::filesystem::rename(tmpPath, path, ec); //Replaces the old file in one step
+    if(!written || ec) 
+    {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Function to copy XML text into an arena
+ * 
+ * @param arena The arena to copy into
+ * @param text The text of a pugixml node or attribute
+ * @param html If HTML tags should be removed from the copy
+ * @return std::string_view The view of the copied text in the arena
+ */
+static std::string_view storeText(RssArena& arena, const char* text, bool html = false)
+{
+    std::string_view stored = arena.store(text, strlen(text));
+    if(!html) return stored;
+
+    char* data = (char*)stored.data(); //The arena gave us this memory, so it is writable
+    size_t size = cleanHTML(data, stored.size()); //Clean the copy in place, never making it longer
+    data[size] = '\0';
+    return std::string_view(data, size);
+}
+
+/**
+ * @brief Function to hash the raw text of every field that an item is made from,
+ * so a refresh can tell if an item was edited without parsing it
+ * 
+ * @param fields The raw title, link, description, author, pubDate, enclosure url, and enclosure type
+ * @param count The number of fields
+ * @return uint64_t The 64 bit FNV-1a hash of the item fields
+ */
+static uint64_t hashItemFields(const char* const* fields, size_t count)
+{
+    uint64_t hash = 14695981039346656037ULL; //FNV-1a offset basis
+    for(size_t i = 0; i < count; ++i)
+    {
+        for(const unsigned char* c = (const unsigned char*)fields[i]; ; ++c) //Hash the null character too so fields can't run together
+        {
+            hash ^= *c;
+            hash *= 1099511628211ULL; //FNV-1a prime
+            if(*c == '\0') break;
+        }
+    }
+    return hash;
+}
+
+/**
+ * @brief The raw text of an item read from any feed format, before it is cleaned and copied into a channel.
+ * The text belongs to the XML document or parser that the item was read from
+ * 
+ */
+struct RawItem
+{
+    const char* title = "";
+    const char* link = "";
+    const char* description = "";
+    const char* author = "";
+    const char* pubDate = "";
+    const char* guid = ""; //What identifies the item between refreshes, the link is used if it is empty
+
+    bool hasEnclosure = false; //If the item has an enclosure, its url and type are "" if they are missing
+    bool hasEnclosureUrl = false;
+    bool hasEnclosureType = false;
+    const char* enclosureUrl = "";
+    const char* enclosureType = "";
+
+    /**
+     * @brief Method to hash the fields of the item with hashItemFields
+     * 
+     * @return uint64_t The hash of the item
+     */
+    uint64_t hash(void) const
+    {
+        const char* fields[] = { title, link, description, author, pubDate, enclosureUrl, enclosureType };
+        return hashItemFields(fields, sizeof(fields) / sizeof(fields[0]));
+    }
+
+    const char* id(void) const { return (*guid != '\0') ? guid : link; } //The guid, or the link if there is no guid
+};
+
+/**
+ * @brief Function to read the raw fields of an RSS 2.0 <item> node
+ * 
+ * @param xmlNode The <item> node
+ * @return RawItem The text of the item
+ * @throw std::runtime_error if the title, link, or description is missing
+ */
+static RawItem rawRssItem(const pugi::xml_node& xmlNode)
+{
+    RawItem raw;
+    raw.title = REQUIRENODE(xmlNode, "title").text().as_string(); //Get the required title of the RSS item
+    raw.link = REQUIRENODE(xmlNode, "link").text().as_string();   //Get the required link to the RSS item
+    raw.description = REQUIRENODE(xmlNode, "description").text().as_string(); //Get the required description of the RSS item
+    raw.author = xmlNode.child("author").text().as_string(); //Get the optional author of the item
+    raw.pubDate = xmlNode.child("pubDate").text().as_string(); //Get the optional publication date of the item
+    raw.guid = xmlNode.child("guid").text().as_string();
+
+    pugi::xml_node enclosure = xmlNode.child("enclosure"); //Get the optional attachment for the item
+    raw.hasEnclosure = !enclosure.empty();
+    raw.hasEnclosureUrl = !enclosure.attribute("url").empty();
+    raw.hasEnclosureType = !enclosure.attribute("type").empty();
+    raw.enclosureUrl = enclosure.attribute("url").as_string();
+    raw.enclosureType = enclosure.attribute("type").as_string();
+    return raw;
+}
+
+/**
+ * @brief Function to read the raw fields of an RSS 1.0 <item> node, which is a child of <rdf:RDF>
+ * 
+ * @param xmlNode The <item> node
+ * @return RawItem The text of the item
+ * @throw std::runtime_error if the title or link is missing
+ */
+static RawItem rawRdfItem(const pugi::xml_node& xmlNode)
+{
+    RawItem raw;
+    raw.title = REQUIRENODE(xmlNode, "title").text().as_string();
+    raw.link = REQUIRENODE(xmlNode, "link").text().as_string();
+    raw.description = xmlNode.child("description").text().as_string(); //The description is optional in RSS 1.0
+    raw.author = xmlNode.child("dc:creator").text().as_string(); //Dublin Core fields stand in for author and pubDate
+    raw.pubDate = xmlNode.child("dc:date").text().as_string();
+    raw.guid = xmlNode.attribute("rdf:about").as_string(); //Every item has a URI that identifies it
+    return raw;
+}
+
+/**
+ * @brief Function to join all of the text inside of an element and its children
+ * 
+ * @param xmlNode The element
+ * @param out The string to append to
+ */
+static void appendInnerText(const pugi::xml_node& xmlNode, std::string& out)
+{
+    for(const pugi::xml_node& child : xmlNode.children())
+    {
+        if(child.type() == pugi::node_pcdata || child.type() == pugi::node_cdata) out += child.value();
+        else if(child.type() == pugi::node_element) appendInnerText(child, out);
+    }
+}
+
+/**
+ * @brief Function to get the text of an Atom text construct like <title> or <summary>.
+ * Text with type="xhtml" is a tree of elements, so all of the text inside of it is joined
+ * 
+ * @param xmlNode The text construct node
+ * @param storage Where xhtml text is joined, it must live as long as the returned text
+ * @return const char* The text of the node
+ */
+static const char* atomText(const pugi::xml_node& xmlNode, std::string& storage)
+{
+    if(strcmp(xmlNode.attribute("type").as_string(), "xhtml") != 0) return xmlNode.text().as_string();
+
+    storage.clear();
+    appendInnerText(xmlNode, storage);
+    return storage.c_str();
+}
+
+/**
+ * @brief Function to read the raw fields of an Atom <entry> node
+ * 
+ * @param xmlNode The <entry> node
+ * @param titleStorage Storage for an xhtml title
+ * @param descriptionStorage Storage for an xhtml summary or content
+ * @return RawItem The text of the item
+ * @throw std::runtime_error if the title is missing
+ */
+static RawItem rawAtomEntry(const pugi::xml_node& xmlNode, std::string& titleStorage, std::string& descriptionStorage)
+{
+    RawItem raw;
+    raw.title = atomText(REQUIRENODE(xmlNode, "title"), titleStorage);
+
+    pugi::xml_node description = xmlNode.child("summary"); //Use the short summary like an RSS description, or the content if there is none
+    if(description.empty()) description = xmlNode.child("content");
+    raw.description = atomText(description, descriptionStorage);
+
+    raw.author = xmlNode.child("author").child("name").text().as_string();
+    raw.pubDate = xmlNode.child("published").text().as_string(); //When the entry was first published, or last updated if that is all there is
+    if(*raw.pubDate == '\0') raw.pubDate = xmlNode.child("updated").text().as_string();
+    raw.guid = xmlNode.child("id").text().as_string();
+
+    bool hasLink = false;
+    for(const pugi::xml_node& link : xmlNode.children("link")) //Entries link to their page and their attachments with the rel attribute
+    {
+        const char* rel = link.attribute("rel").as_string("alternate");
+        if(strcmp(rel, "alternate") == 0 && !hasLink)
+        {
+            raw.link = link.attribute("href").as_string();
+            hasLink = true;
+        }
+        else if(strcmp(rel, "enclosure") == 0 && !raw.hasEnclosure)
+        {
+            raw.hasEnclosure = true;
+            raw.hasEnclosureUrl = !link.attribute("href").empty();
+            raw.hasEnclosureType = !link.attribute("type").empty();
+            raw.enclosureUrl = link.attribute("href").as_string();
+            raw.enclosureType = link.attribute("type").as_string();
+        }
+    }
+    return raw;
+}
+
+/**
+ * @brief Function to clean the raw fields of an item and copy them into an arena
+ * 
+ * @param raw The raw item
+ * @param arena The arena of the channel that the item is for
+ * @return RssItem The item
+ */
+static RssItem buildItem(const RawItem& raw, RssArena& arena)
+{
+    RssItem item;
+
+    //Copy all text into the channel arena, stripping any HTML tags from the title and description
+    item.title = storeText(arena, raw.title, true);
+    item.link = storeText(arena, raw.link);
+    item.description = storeText(arena, raw.description, true);
+    item.author = storeText(arena, raw.author);
+    item.pubDate = storeText(arena, raw.pubDate);
+    item.published = parseFeedDate(item.pubDate); //Read the date once here so items can be sorted without reading it again
+
+    item.guid = storeText(arena, raw.id()); //Remember what identifies the item so the next refresh can find it
+    item.contentHash = raw.hash();
+
+    if(raw.hasEnclosure) //Only image attachments are kept
+    {
+        if(!raw.hasEnclosureType) logW("XML node 'enclosure' missing required attribute: %s", "'type'");
+        else if(strncmp(raw.enclosureType, "image/", strlen("image/")) != 0) logW("Enclosure found in RSS item, but it is an unsupported content type: %s", raw.enclosureType);
+        else if(!raw.hasEnclosureUrl) logW("XML node 'enclosure' missing required attribute: %s", "'url'");
+        else
+        {
+            //Note: filled is not set for the image here, the GUI loads the image data later if the user wants it
+            item.enclosure.title = "Attachment";
+            item.enclosure.url = storeText(arena, raw.enclosureUrl);
+        }
+    }
+    return item;
+}
+
+
+/**
+ * @brief Function to get the bit of RssChannel::skipHours for the text of an <hour> node
+ * 
+ * @param text The text of the node
+ * @return uint32_t The bit for the hour, 0 if it isn't an hour
+ */
+static uint32_t skipHourBit(const char* text)
+{
+    char* end;
+    long h = strtol(text, &end, 10);
+    if(end == text || h < 0 || h > 24) return 0;
+    return 1u << (h % 24); //Some feeds use 24 for midnight
+}
+
+/**
+ * @brief Function to get the bit of RssChannel::skipDays for the text of a <day> node
+ * 
+ * @param text The text of the node
+ * @return uint32_t The bit for the day, 0 if it isn't a day
+ */
+static uint32_t skipDayBit(std::string text)
+{
+    static const char* DAY_NAMES[] = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
+    cleanWhiteSpace(text);
+    for(uint32_t d = 0; d < 7; ++d)
+    {
+        if(text == DAY_NAMES[d]) return 1u << d;
+    }
+    return 0;
+}
+
+/**
+ * @brief Function to copy an image into another arena
+ * 
+ * @param img The image to copy
+ * @param arena The arena to copy the image text into
+ * @return RssImage The copied image
+ */
+static RssImage copyImage(const RssImage& img, RssArena& arena)
+{
+    RssImage copy = img;
+    copy.title = arena.store(img.title.data(), img.title.size());
+    copy.url = arena.store(img.url.data(), img.url.size());
+    copy.description = arena.store(img.description.data(), img.description.size());
+    return copy;
+}
+
+/**
+ * @brief Function to copy an item that was already parsed and cleaned into another arena
+ * 
+ * @param item The item to copy
+ * @param arena The arena to copy the item text into
+ * @return RssItem The copied item
+ */
+static RssItem copyItem(const RssItem& item, RssArena& arena)
+{
+    RssItem copy;
+    copy.guid = arena.store(item.guid.data(), item.guid.size());
+    copy.contentHash = item.contentHash;
+    copy.title = arena.store(item.title.data(), item.title.size());
+    copy.description = arena.store(item.description.data(), item.description.size());
+    copy.link = arena.store(item.link.data(), item.link.size());
+    copy.pubDate = arena.store(item.pubDate.data(), item.pubDate.size());
+    copy.published = item.published;
+    copy.author = arena.store(item.author.data(), item.author.size());
+    copy.enclosure = copyImage(item.enclosure, arena);
+    return copy;
+}
+
+RssImage RssImage::fromXML(const pugi::xml_node& xmlNode, RssArena& arena)
+{
+    RssImage retImg; //The returned image struct with all data filled in
+    if(xmlNode.empty()) return retImg; //Return non filled img struct if the node is empty
+
+    try
     {
-        auto startpos = str.find("<");
-        auto endpos = str.find(">") + 1;
+        retImg.title = storeText(arena, REQUIRENODE(xmlNode, "title").text().as_string()); //Get the title of the RSS image
+        retImg.url = storeText(arena, REQUIRENODE(xmlNode, "url").text().as_string()); //Get the image source URL 
+
+        retImg.width = (xmlNode.child("width").empty()) ? retImg.width : xmlNode.child("width").text().as_uint(); //Get the width or keep it the same if it isn't specifief
+        retImg.height = (xmlNode.child("height").empty()) ? retImg.height : xmlNode.child("height").text().as_uint(); //Same with height
 
-        if (endpos != std::string::npos)
+        retImg.description = storeText(arena, xmlNode.child("description").text().as_string()); //Get the optional description of the image
+    }
+    catch(const std::exception& e) //Catch any REQUIRENODE errors and return a bad img struct if they occur
+    {
+        logE("Failed to get image from RSS: %s", e.what());
+        return retImg;
+    }
+
+    retImg.filled = true; //If no errors were thrown at all, set the filled attribute to true on the image
+    return retImg;
+    
+}
+
+RssImageData RssImage::loadImgFromUrl(const std::string t_url, RssImageCache* cache)
+{
+    RssImageCache::Entry cached; //The image from the last download, if there was one
+    bool isCached = cache != NULL && cache->load(t_url, cached);
+    std::string downloaded;
+    const std::string* encoded = &cached.body; //The image bytes to decode
+
+    if(!isCached || !cache->isFresh(cached)) //Only use the network if the image isn't cached or it is time to check if it changed
+    {
+        cpr::Header reqHeaders; //Validators from the cached copy, so the server can tell us nothing changed
+        if(isCached && !cached.etag.empty()) reqHeaders["If-None-Match"] = cached.etag;
+        if(isCached && !cached.lastModified.empty()) reqHeaders["If-Modified-Since"] = cached.lastModified;
+
+        //Make a GET request for the image data to load from the enclosure URL, reusing a connection to the host if there is one
+        cpr::Response imgResp = RssSessionPool::instance().get(t_url, reqHeaders); 
+        bool okStatus = imgResp.status_code == 304 || (imgResp.status_code >= 200 && imgResp.status_code < 300);
+        if(isCached && (imgResp.error.code != cpr::ErrorCode::OK || !okStatus)) //Show the image we have instead of losing it because the check failed, and check again next time
+        {
+            logW("Failed to check cached image %s for changes (status %ld, %s), using the cached copy", t_url.c_str(), imgResp.status_code, imgResp.error.message.c_str());
+        }
+        //Log any errors that occur from getting the image
+        else if(imgResp.error.code != cpr::ErrorCode::OK) throw std::runtime_error(std::string("HTTP GET request for image failed! EC: ") + std::to_string((unsigned int)imgResp.error.code) + " Reason: " + imgResp.error.message);
+        else if(imgResp.status_code == 304 && isCached) //The cached image is still good, remember that it was checked
         {
-            str.erase(startpos, endpos - startpos);
+            cached.fetchedAt = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            if(cache != NULL) cache->touch(t_url, cached); //Only the time changed, so don't write the image again
         }
+        else
+        {
+            downloaded = std::move(imgResp.text);
+            encoded = &downloaded;
+            if(cache != NULL && imgResp.status_code >= 200 && imgResp.status_code < 300) //Keep the image for the next time it is shown
+            {
+                cached.fetchedAt = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+                cached.etag = imgResp.header["ETag"];
+                cached.lastModified = imgResp.header["Last-Modified"];
+                cached.body.swap(downloaded);
+                encoded = &cached.body;
+                cache->store(t_url, cached);
+            }
+        }
+    }
+    
+    RssImageData img; //The decoded image to return
+    img.url = t_url;
+
+    //Decode the image straight from the buffer, so no temp file is shared between threads
+    int ch; //The number of channels in the source image, we always decode to 4
+    unsigned char* imgDat = stbi_load_from_memory((const stbi_uc*)encoded->data(), (int)encoded->size(), &img.width, &img.height, &ch, 4);
+    if(imgDat == NULL) throw std::runtime_error(std::string("Failed to decode image data! Reason: ") + stbi_failure_reason()); //Throw an error if stb_image somehow fails
+
+    img.pixels.assign(imgDat, imgDat + (size_t)img.width * img.height * 4); //Copy the pixels out so the buffer can be moved between threads
+    stbi_image_free(imgDat); //No memory leaks here 
+
+    return img;
+}
+
+RssItem RssItem::fromXML(const pugi::xml_node& xmlNode, RssArena& arena)
+{
+    if(xmlNode.empty()) throw std::runtime_error("Attempted to construct an RSS item from an empty XML node"); //Make sure the XML node exists
+    return buildItem(rawRssItem(xmlNode), arena); //Propogate any error upwards to the caller if a required field is missing
+}
+
+/**
+ * @brief The number of items that a channel keeps, items that a feed no longer publishes
+ * are kept from earlier refreshes until a channel has this many
+ */
+static const size_t MAX_CHANNEL_ITEMS = 1000;
+
+/**
+ * @brief Function to index the items of a previous channel by guid, so
+ * a refresh can find the items that it already has
+ * 
+ * @param previous The previous channel, or NULL
+ * @param index The index to fill
+ */
+static void indexPreviousItems(const RssChannel* previous, std::unordered_map<std::string_view, const RssItem*>& index)
+{
+    if(previous == NULL) return;
+    index.reserve(previous->items.size());
+    for(const RssItem& item : previous->items) index.emplace(item.guid, &item);
+}
+
+/**
+ * @brief Function to keep the items of a previous channel that a refreshed feed stopped publishing
+ * 
+ * @param channel The refreshed channel, with every item the feed published
+ * @param previous The previous channel, or NULL
+ * @param unmatched The index of previous items that weren't found in the refreshed feed
+ * @param reused The number of items that were copied from the previous channel
+ */
+static void keepPreviousItems(RssChannel& channel, const RssChannel* previous, std::unordered_map<std::string_view, const RssItem*>& unmatched, size_t reused)
+{
+    if(previous == NULL) return;
+
+    size_t published = channel.items.size();
+    for(const RssItem& item : previous->items) //Keep items that the feed stopped publishing, in the same order as before
+    {
+        if(channel.items.size() >= MAX_CHANNEL_ITEMS) break;
+        if(unmatched.erase(item.guid) != 0) channel.items.push_back(copyItem(item, *channel.arena));
+    }
+    logI("Merged RSS feed from %s: %zu new or changed items, %zu unchanged, %zu kept from earlier refreshes", channel.link.c_str(), published - reused, reused, channel.items.size() - published);
+}
+
+/**
+ * @brief Function to add an item to a channel, copying the item from the previous channel
+ * if it has the same guid and wasn't edited
+ * 
+ * @param channel The channel to add the item to
+ * @param raw The raw item
+ * @param previousItems The index of previous items that weren't found yet, the item is removed from it
+ * @param reused The number of items copied from the previous channel so far
+ */
+static void addItem(RssChannel& channel, const RawItem& raw, std::unordered_map<std::string_view, const RssItem*>& previousItems, size_t& reused)
+{
+    auto found = previousItems.find(raw.id());
+    if(found != previousItems.end()) 
+    {
+        const RssItem* old = found->second;
+        previousItems.erase(found); //Each old item is only used once, whatever is left over is history
+        if(old->contentHash == raw.hash()) //The item wasn't edited, so copy it without cleaning it again
+        {
+            channel.items.push_back(copyItem(*old, *channel.arena));
+            ++reused;
+            return;
+        }
+    }
+
+    channel.items.push_back(buildItem(raw, *channel.arena));
+}
+
+RssChannel RssChannel::fromXML(const pugi::xml_document& xmlDoc, const std::string link, const RssChannel* previous)
+{
+    if(xmlDoc.empty()) throw std::runtime_error("Attempted to parse an empty XML document!"); //Throw an error if the XML node is not valid
+
+    RssChannel retChannel; //The constructed RSS channel object to return
+    retChannel.link = link; //Set the source URL for this channel
+    cleanWhiteSpace(retChannel.link);
+    retChannel.ttl = 0;
+    retChannel.arena = std::make_shared<RssArena>(); //One arena for all of the channel's text
+
+    std::unordered_map<std::string_view, const RssItem*> previousItems; //Every item of the last refresh by guid
+    indexPreviousItems(previous, previousItems);
+    size_t reused = 0; //The number of items that didn't change since the last refresh
+
+    //Method to read every item node of the channel, logging the items that fail instead of throwing
+    auto readItems = [&](const pugi::xml_node& parent, const char* name, auto rawItem) -> void
+    {
+        for(const pugi::xml_node& item : parent.children(name)) //For every item in the channel...
+        {
+            try
+            {
+                addItem(retChannel, rawItem(item), previousItems, reused); //Attempt to make an item from the XML data and add it to the list of items
+            }
+            catch(const std::exception& e) //Catch any error creating the item and log them, don't throw them
+            {
+                logE("Failed to construct item from XML: %s", e.what());
+            }
+        }
+    };
+
+    pugi::xml_node root = xmlDoc.document_element(); //The root element tells which format the feed is in
+    const char* atomLogo = ""; //The image of an Atom feed, which is titled after the cleaned channel title
+    if(strcmp(root.name(), "feed") == 0) //Atom, where the root is the channel and entries are items
+    {
+        std::string titleStorage, descriptionStorage;
+        retChannel.title = atomText(REQUIRENODE(root, "title"), titleStorage);
+        retChannel.description = atomText(root.child("subtitle"), descriptionStorage);
+
+        atomLogo = root.child("logo").text().as_string(); //Use the wide logo as the channel image, or the square icon
+        if(*atomLogo == '\0') atomLogo = root.child("icon").text().as_string();
+        readItems(root, "entry", [&](const pugi::xml_node& entry) { return rawAtomEntry(entry, titleStorage, descriptionStorage); });
+    }
+    else if(strcmp(root.name(), "rdf:RDF") == 0) //RSS 1.0, where the image and items are next to the channel instead of in it
+    {
+        pugi::xml_node channelNode = REQUIRENODE(root, "channel");
+        retChannel.title = REQUIRENODE(channelNode, "title").text().as_string();
+        retChannel.description = REQUIRENODE(channelNode, "description").text().as_string();
+        retChannel.image = RssImage::fromXML(root.child("image"), *retChannel.arena);
+
+        readItems(root, "item", rawRdfItem);
+    }
+    else //RSS 2.0
+    {
+        pugi::xml_node channelNode = REQUIRENODE( REQUIRENODE(xmlDoc, "rss"), "channel"); //Require the RSS channel node 
+
+        retChannel.title = REQUIRENODE(channelNode, "title").text().as_string(); //Get the title string of the RSS channel
+        retChannel.description = REQUIRENODE(channelNode, "description").text().as_string(); //Get the description of the RSS channel
+        retChannel.ttl = ( ( channelNode.child("ttl").empty() ) ? 0ULL : channelNode.child("ttl").text().as_ullong() ); //Get optional ttl parameter
+
+        for(const pugi::xml_node& hour : channelNode.child("skipHours").children("hour")) //Hours in UTC that the feed shouldn't be refreshed
+        {
+            retChannel.skipHours |= skipHourBit(hour.text().as_string());
+        }
+        for(const pugi::xml_node& day : channelNode.child("skipDays").children("day")) //Days that the feed shouldn't be refreshed
+        {
+            retChannel.skipDays |= skipDayBit(day.text().as_string());
+        }
+
+        retChannel.image = RssImage::fromXML(channelNode.child("image"), *retChannel.arena); //Get the image attribute of the Rss Channel
+        readItems(channelNode, "item", rawRssItem);
+    }
+
+    keepPreviousItems(retChannel, previous, previousItems, reused);
+
+    //Clean RSS channel title and description of any whitespace and HTML tags
+    cleanWhiteSpace(retChannel.title);
+    cleanHTML(retChannel.description); 
+    cleanHTML(retChannel.title);
+
+    if(*atomLogo != '\0')
+    {
+        retChannel.image.title = storeText(*retChannel.arena, retChannel.title.c_str());
+        retChannel.image.url = storeText(*retChannel.arena, atomLogo);
+        retChannel.image.filled = true;
+    }
+
+    retChannel.sortByDate();
+    return retChannel;
+}
+
+/**
+ * @brief Function to load a cached RSS file into a pugixml document and build the channel
+ * from it, used when RssStreamParser can't read a feed, like one that isn't UTF-8
+ * 
+ * @param link The link that the cached RSS feed originated from
+ * @param previous The channel to merge items from, or NULL
+ * @return RssChannel The constructed RSS channel
+ * @throw std::runtime_error if the cache file is missing or XML parsing fails
+ */
+static RssChannel channelFromCacheDocument(const std::string& link, const RssChannel* previous)
+{
+    std::string cachePath = cachePathFor(link); //The cached XML file path
+
+    FILE* cacheFile = fopen(cachePath.c_str(), "rb");
+    if(cacheFile == NULL) throw std::runtime_error("No cached RSS file at " + cachePath);
+
+    fseek(cacheFile, 0, SEEK_END); //Get the size of the file to read it all at once
+    long size = ftell(cacheFile);
+    fseek(cacheFile, 0, SEEK_SET);
+
+    //Read into a buffer from pugixml's allocator so the document can take it and parse in place
+    void* buffer = (size > 0) ? pugi::get_memory_allocation_function()((size_t)size) : NULL;
+    bool read = buffer != NULL && fread(buffer, 1, (size_t)size, cacheFile) == (size_t)size;
+    fclose(cacheFile);
+    if(!read)
+    {
+        if(buffer != NULL) pugi::get_memory_deallocation_function()(buffer);
+        throw std::runtime_error("Failed to read cached RSS file " + cachePath);
+    }
+
+    pugi::xml_document doc; //The xml document to load the cache from
+    pugi::xml_parse_result res = doc.load_buffer_inplace_own(buffer, (size_t)size); //The document frees the buffer
+    if(!res) //If the XML parsing failed, throw the error
+    {
+        throw std::runtime_error("Failed to parse cached XML file from " + cachePath + "! Error: " + res.description());
+    }
+
+    return RssChannel::fromXML(doc, link, previous); //Make the rss channel from the XML document loaded
+}
+
+RssChannel RssChannel::fromUrl(const std::string url, const std::string etag, const std::string lastModified, const RssChannel* previous, std::function<void(const RssChannel&)> onPartial)
+{
+    cpr::Header reqHeaders; //Validators from the last download, so the server can tell us nothing changed
+    if(!etag.empty()) reqHeaders["If-None-Match"] = etag;
+    if(!lastModified.empty()) reqHeaders["If-Modified-Since"] = lastModified;
+
+    //Write the feed to the cache exactly as it is received, and only replace the old cache file when the download worked
+    std::string cachePath = cachePathFor(url);
+    std::string tempPath = uniqueTempPath(cachePath); //A background refresh and the user can download the same feed at once
+    FILE* tempFile = fopen(tempPath.c_str(), "wb");
+    if(tempFile == NULL) logW("Failed to open cache file %s for RSS feed from URL %s", tempPath.c_str(), url.c_str());
+
+    std::unique_ptr<RssStreamParser> parser(new RssStreamParser(url, previous)); //Replaced if the download is retried
+    bool streaming = true; //If the stream parser can still read the feed, otherwise the cache file is parsed after the download
+    size_t reportedItems = 0; //Items that onPartial was already called with
+    size_t decodedBytes = 0;  //The body size after curl decompressed it
+    size_t wireBytes = 0;
+    auto lastReport = std::chrono::steady_clock::now();
+
+    cpr::Response resp = RssSessionPool::instance().download(url, reqHeaders, cpr::WriteCallback{[&](std::string data) -> bool 
+    {
+        decodedBytes += data.size();
+        if(tempFile != NULL && fwrite(data.data(), 1, data.size(), tempFile) != data.size())
+        {
+            logW("Failed to write cache file %s", tempPath.c_str());
+            fclose(tempFile);
+            tempFile = NULL;
+        }
+
+        if(streaming && !parser->feed(data.data(), data.size()))
+        {
+            logW("Can't parse RSS feed from URL %s while downloading: %s, parsing the cache file instead", url.c_str(), parser->error().c_str());
+            streaming = false;
+        }
+        if(!streaming && tempFile == NULL) return false; //Nothing can read the feed, so stop downloading it
+
+        auto now = std::chrono::steady_clock::now();
+        if(streaming && onPartial && previous == NULL && parser->itemCount() > reportedItems && now - lastReport > std::chrono::milliseconds(100)) //Show the first items before the download finishes
+        {
+            RssChannel partial = parser->partial();
+            partial.lastChecked = std::chrono::duration_cast<std::chrono::minutes>(std::chrono::system_clock::now().time_since_epoch()).count();
+            partial.sortByDate();
+            onPartial(partial);
+            reportedItems = parser->itemCount();
+            lastReport = now;
+        }
+        return true;
+    }}, &wireBytes, 5000, [&](void) //The host asked us to come back soon, so throw away the error page it sent before trying again
+    {
+        if(tempFile != NULL) fclose(tempFile);
+        tempFile = fopen(tempPath.c_str(), "wb");
+        if(tempFile == NULL) logW("Failed to open cache file %s for RSS feed from URL %s", tempPath.c_str(), url.c_str());
+        parser.reset(new RssStreamParser(url, previous));
+        streaming = true;
+        decodedBytes = 0;
+    }); //Get the RSS feed from the recorded URL, reusing a connection to the host if there is one
+
+    bool written = tempFile != NULL;
+    if(tempFile != NULL) written = fclose(tempFile) == 0;
+
+    if(resp.error.code != cpr::ErrorCode::OK || resp.status_code < 200 || resp.status_code >= 300) //Keep the old cache file if the download failed
+    {
+        std::remove(tempPath.c_str());
+        if(resp.error.code != cpr::ErrorCode::OK) throw std::runtime_error("HTTP GET request failed with error: " + resp.error.message); //If any error occured, throw it
+        if(resp.status_code != 304) throw std::runtime_error("HTTP GET request failed with status " + std::to_string(resp.status_code));
+    }
+
+    if(resp.status_code == 304) //The feed wasn't modified since the last download, so use the cached channel
+    {
+        if(previous != NULL) //Nothing changed since the channel we already have, so keep it as it is
+        {
+            RssChannel sameCh = *previous; //Shares the arena of the previous channel
+            sameCh.lastChecked = std::chrono::duration_cast<std::chrono::minutes>(std::chrono::system_clock::now().time_since_epoch()).count();
+            sameCh.wireBytes = sameCh.decodedBytes = 0; //Nothing was downloaded this time
+
+            logI("RSS feed from URL %s was not modified, keeping channel \'%s\'", url.c_str(), sameCh.title.c_str());
+            return sameCh;
+        }
+
+        try
+        {
+            RssChannel cachedCh = RssChannel::fromCache(url);
+            cachedCh.etag = etag; //Keep the same validators for the next request
+            cachedCh.lastModified = lastModified;
+            cachedCh.lastChecked = std::chrono::duration_cast<std::chrono::minutes>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+            logI("RSS feed from URL %s was not modified, using cached channel \'%s\'", url.c_str(), cachedCh.title.c_str());
+            return cachedCh;
+        }
+        catch(const std::exception& e) //If the cache is gone, download the whole feed again
+        {
+            logW("RSS feed from URL %s was not modified but the cache failed to load: %s, downloading again...", url.c_str(), e.what());
+            return RssChannel::fromUrl(url, "", "", previous, onPartial);
+        }
+    }
+
+    if(written)
+    {
+        std::error_code renameErr;
+        std::filesystem::rename(tempPath, cachePath, renameErr); //Readers of the cache see the whole old file or the whole new file
+        if(renameErr)
+        {
+            logW("Failed to replace cache file %s: %s", cachePath.c_str(), renameErr.message().c_str());
+            std::remove(tempPath.c_str());
+            written = false;
+        }
+    }
+
+    RssChannel rssCh;
+    if(streaming) rssCh = parser->finish(); //Finish the channel that was built while downloading
+    else if(written) rssCh = channelFromCacheDocument(url, previous);
+    else throw std::runtime_error("Failed to parse RSS feed from " + url + " and failed to cache it to parse it again");
+
+    //Use wordy chrono library to get time in minutes since a known date that this feed was refreshed
+    rssCh.lastChecked = std::chrono::duration_cast<std::chrono::minutes>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    rssCh.etag = resp.header["ETag"]; //Remember the validators to make the next request conditional
+    rssCh.lastModified = resp.header["Last-Modified"];
+    rssCh.wireBytes = wireBytes;
+    rssCh.decodedBytes = decodedBytes;
+
+    logI("Loaded RSS feed from URL %s, %zu bytes downloaded for %zu bytes of XML", url.c_str(), wireBytes, decodedBytes);
+    return rssCh;
+}
+
+RssChannel RssChannel::fromCache(const std::string link)
+{
+    std::string cachePath = cachePathFor(link); //The cached XML file path
+
+    FILE* cacheFile = fopen(cachePath.c_str(), "rb");
+    if(cacheFile == NULL) throw std::runtime_error("No cached RSS file at " + cachePath);
+
+    RssStreamParser parser(link);
+    std::vector<char> piece(64 * 1024); //Only this much of the file is in memory at once
+    bool parsed = true;
+    size_t read;
+    while(parsed && (read = fread(piece.data(), 1, piece.size(), cacheFile)) > 0)
+    {
+        parsed = parser.feed(piece.data(), read);
+    }
+    fclose(cacheFile);
+
+    if(parsed) return parser.finish();
+
+    logW("Can't stream cached RSS file %s: %s, loading the whole file instead", cachePath.c_str(), parser.error().c_str());
+    return channelFromCacheDocument(link, NULL);
+}
+
+RssStreamParser::RssStreamParser(const std::string& link, const RssChannel* t_previous) : xml(*this), previous(t_previous)
+{
+    channel.link = link; //Set the source URL for this channel
+    cleanWhiteSpace(channel.link);
+    channel.ttl = 0;
+    channel.arena = std::make_shared<RssArena>(); //One arena for all of the channel's text
+    indexPreviousItems(previous, previousItems);
+}
+
+bool RssStreamParser::feed(const char* data, size_t size)
+{
+    return xml.feed(data, size);
+}
+
+RssChannel RssStreamParser::finish(void)
+{
+    if(!xml.finish()) throw std::runtime_error("Failed to parse XML from " + channel.link + "! Error: " + xml.error());
+
+    //The same errors as RssChannel::fromXML for missing required nodes
+    if(format == FORMAT_NONE) throw std::runtime_error("No XML node named rss found!");
+    if(!sawChannel) throw std::runtime_error("No XML node named channel found!");
+    if(!channelTitle.present) throw std::runtime_error("No XML node named title found!");
+    if(!channelDescription.present && format != FORMAT_ATOM) throw std::runtime_error("No XML node named description found!");
+
+    if(format == FORMAT_ATOM) //Use the wide logo as the channel image, or the square icon
+    {
+        const std::string& logo = (!channelLogo.text.empty()) ? channelLogo.text : channelIcon.text;
+        if(!logo.empty())
+        {
+            channel.image.title = storeText(*channel.arena, channel.title.c_str());
+            channel.image.url = storeText(*channel.arena, logo.c_str());
+            channel.image.filled = true;
+        }
+    }
+
+    keepPreviousItems(channel, previous, previousItems, reused);
+    channel.sortByDate();
+    return std::move(channel);
+}
+
+void RssStreamParser::startField(Field& f)
+{
+    if(f.present) return; //Only the first element with a name is read
+    f.present = true;
+    field = &f;
+    fieldDepth = depth;
+}
+
+void RssStreamParser::startAtomText(Field& f, const RssXmlAttribute* attributes, size_t count)
+{
+    if(f.present) return;
+    startField(f);
+    for(size_t i = 0; i < count; ++i)
+    {
+        if(attributes[i].name == "type") 
+        {
+            f.inner = (attributes[i].value == "xhtml");
+            break;
+        }
+    }
+}
+
+void RssStreamParser::readAtomLink(const RssXmlAttribute* attributes, size_t count)
+{
+    std::string_view rel = "alternate", href, type; //A link without a rel is the entry's page
+    bool hasHref = false, hasType = false;
+    for(size_t i = 0; i < count; ++i) //Keep the first of each attribute like pugixml's attribute()
+    {
+        if(attributes[i].name == "rel" && rel == "alternate") rel = attributes[i].value;
+        else if(attributes[i].name == "href" && !hasHref) 
+        {
+            href = attributes[i].value;
+            hasHref = true;
+        }
+        else if(attributes[i].name == "type" && !hasType)
+        {
+            type = attributes[i].value;
+            hasType = true;
+        }
+    }
+
+    if(rel == "alternate" && !itemLink.present)
+    {
+        itemLink.present = itemLink.hasText = true;
+        itemLink.text.assign(href);
+    }
+    else if(rel == "enclosure" && !itemHasEnclosure)
+    {
+        itemHasEnclosure = true;
+        enclosureHasUrl = hasHref;
+        enclosureHasType = hasType;
+        enclosureUrl.assign(href);
+        enclosureType.assign(type);
+    }
+}
+
+void RssStreamParser::startElement(std::string_view name, const RssXmlAttribute* attributes, size_t count)
+{
+    ++depth;
+    if(depth == 1) //The root element tells which format the feed is in
+    {
+        if(name == "rss") format = FORMAT_RSS;
+        else if(name == "feed") format = FORMAT_ATOM;
+        else if(name == "rdf:RDF") format = FORMAT_RDF;
+        itemDepth = (format == FORMAT_RSS) ? 3 : 2;
+        if(format == FORMAT_ATOM) inChannel = sawChannel = true; //The <feed> is the channel
+        return;
+    }
+    if(format == FORMAT_NONE) return;
+
+    if(depth == 2 && format != FORMAT_ATOM && name == "channel")
+    {
+        if(!sawChannel) inChannel = sawChannel = true;
+        return;
+    }
+
+    if(depth == itemDepth && scope == SCOPE_NONE && (inChannel || format == FORMAT_RDF)) //Items and the image, which are next to the channel in RSS 1.0
+    {
+        if(name == ((format == FORMAT_ATOM) ? "entry" : "item"))
+        {
+            scope = SCOPE_ITEM;
+            itemTitle.reset(); itemLink.reset(); itemDescription.reset(); itemAuthor.reset(); itemPubDate.reset(); itemGuid.reset();
+            itemContent.reset(); itemUpdated.reset();
+            itemHasEnclosure = enclosureHasUrl = enclosureHasType = false;
+            enclosureUrl.clear(); 
+            enclosureType.clear();
+
+            for(size_t i = 0; format == FORMAT_RDF && i < count; ++i) //RSS 1.0 items are identified by a URI
+            {
+                if(attributes[i].name != "rdf:about") continue;
+                itemGuid.present = itemGuid.hasText = true;
+                itemGuid.text.assign(attributes[i].value);
+                break;
+            }
+            return;
+        }
+        if(name == "image" && format != FORMAT_ATOM && !sawImage) 
+        {
+            scope = SCOPE_IMAGE;
+            sawImage = true;
+            return;
+        }
+    }
+
+    size_t channelFieldDepth = (format == FORMAT_ATOM) ? 2 : 3;
+    if(depth == channelFieldDepth && scope == SCOPE_NONE && inChannel) //Children of the channel
+    {
+        if(format == FORMAT_ATOM)
+        {
+            if(name == "title") startAtomText(channelTitle, attributes, count);
+            else if(name == "subtitle") startAtomText(channelDescription, attributes, count);
+            else if(name == "logo") startField(channelLogo);
+            else if(name == "icon") startField(channelIcon);
+            return;
+        }
+
+        if(name == "title") startField(channelTitle);
+        else if(name == "description") startField(channelDescription);
+        else if(format != FORMAT_RSS) return;
+        else if(name == "ttl") startField(channelTtl);
+        else if(name == "skipHours" && !sawSkipHours)
+        {
+            scope = SCOPE_SKIP_HOURS;
+            sawSkipHours = true;
+        }
+        else if(name == "skipDays" && !sawSkipDays)
+        {
+            scope = SCOPE_SKIP_DAYS;
+            sawSkipDays = true;
+        }
+        return;
+    }
+
+    if(scope == SCOPE_ITEM && format == FORMAT_ATOM && inAuthor && depth == itemDepth + 2) //The name of an Atom entry's author
+    {
+        if(name == "name") startField(itemAuthor);
+        return;
+    }
+
+    size_t childDepth = (scope == SCOPE_SKIP_HOURS || scope == SCOPE_SKIP_DAYS) ? channelFieldDepth + 1 : itemDepth + 1;
+    if(depth != childDepth) return;
+    switch(scope) //Children of the open item, image, or skip list
+    {
+        case SCOPE_ITEM:
+            if(format == FORMAT_ATOM)
+            {
+                if(name == "title") startAtomText(itemTitle, attributes, count);
+                else if(name == "link") readAtomLink(attributes, count);
+                else if(name == "summary") startAtomText(itemDescription, attributes, count);
+                else if(name == "content") startAtomText(itemContent, attributes, count);
+                else if(name == "author" && !itemAuthor.present) inAuthor = true;
+                else if(name == "published") startField(itemPubDate);
+                else if(name == "updated") startField(itemUpdated);
+                else if(name == "id") startField(itemGuid);
+            }
+            else if(format == FORMAT_RDF)
+            {
+                if(name == "title") startField(itemTitle);
+                else if(name == "link") startField(itemLink);
+                else if(name == "description") startField(itemDescription);
+                else if(name == "dc:creator") startField(itemAuthor);
+                else if(name == "dc:date") startField(itemPubDate);
+            }
+            else if(name == "title") startField(itemTitle);
+            else if(name == "link") startField(itemLink);
+            else if(name == "description") startField(itemDescription);
+            else if(name == "author") startField(itemAuthor);
+            else if(name == "pubDate") startField(itemPubDate);
+            else if(name == "guid") startField(itemGuid);
+            else if(name == "enclosure" && !itemHasEnclosure) 
+            {
+                itemHasEnclosure = true;
+                for(size_t i = 0; i < count; ++i) //Keep the first url and type like pugixml's attribute()
+                {
+                    if(attributes[i].name == "url" && !enclosureHasUrl)
+                    {
+                        enclosureUrl.assign(attributes[i].value);
+                        enclosureHasUrl = true;
+                    }
+                    else if(attributes[i].name == "type" && !enclosureHasType)
+                    {
+                        enclosureType.assign(attributes[i].value);
+                        enclosureHasType = true;
+                    }
+                }
+            }
+            break;
+
+        case SCOPE_IMAGE:
+            if(name == "title") startField(imageTitle);
+            else if(name == "url") startField(imageUrl);
+            else if(name == "description") startField(imageDescription);
+            else if(name == "width") startField(imageWidth);
+            else if(name == "height") startField(imageHeight);
+            break;
+
+        case SCOPE_SKIP_HOURS:
+            if(name == "hour") startField(skipValue);
+            break;
+
+        case SCOPE_SKIP_DAYS:
+            if(name == "day") startField(skipValue);
+            break;
+
+        default:
+            break;
     }
 }
 
-RssImage RssImage::fromXML(const pugi::xml_node& xmlNode)
+void RssStreamParser::endElement(std::string_view) //RssXmlStream already checked that the name matches the open element, so only the depth is needed
 {
-    RssImage retImg; //The returned image struct with all data filled in
-    if(xmlNode.empty()) return retImg; //Return non filled img struct if the node is empty
-
-    try
+    if(field != NULL && depth == fieldDepth) //The field's element closed
     {
-        retImg.title = REQUIRENODE(xmlNode, "title").text().as_string(); //Get the title of the RSS image
-        retImg.url = REQUIRENODE(xmlNode, "url").text().as_string(); //Get the image source URL 
-
-        retImg.width = (xmlNode.child("width").empty()) ? retImg.width : xmlNode.child("width").text().as_uint(); //Get the width or keep it the same if it isn't specifief
-        retImg.height = (xmlNode.child("height").empty()) ? retImg.height : xmlNode.child("height").text().as_uint(); //Same with height
-
-        try
+        if(field == &channelTitle) //Clean the channel title and description right away so partial channels can be shown
         {
-            retImg.loadImgFromUrl(retImg.url); //Get the error from loading the image
+            channel.title = channelTitle.text;
+            cleanWhiteSpace(channel.title);
+            cleanHTML(channel.title);
         }
-        catch(const std::exception& e) //Check if any errors occured ant throw them
+        else if(field == &channelDescription) 
         {
-            throw e;
+            channel.description = channelDescription.text;
+            cleanHTML(channel.description);
         }
-
-        retImg.description = xmlNode.child("description").text().as_string(); //Get the optional description of the image
+        else if(field == &channelTtl) channel.ttl = std::strtoull(channelTtl.text.c_str(), NULL, 10);
+        else if(field == &skipValue) //Every <hour> or <day> is read, not only the first
+        {
+            if(scope == SCOPE_SKIP_HOURS) channel.skipHours |= skipHourBit(skipValue.text.c_str());
+            else channel.skipDays |= skipDayBit(skipValue.text);
+            skipValue.reset();
+        }
+        field = NULL;
     }
-    catch(const std::exception& e) //Catch any REQUIRENODE errors and return a bad img struct if they occur
+
+    if(inAuthor && depth == itemDepth + 1) inAuthor = false;
+
+    size_t scopeDepth = (scope == SCOPE_SKIP_HOURS || scope == SCOPE_SKIP_DAYS) ? ((format == FORMAT_ATOM) ? 2 : 3) : itemDepth;
+    if(scope != SCOPE_NONE && depth == scopeDepth)
     {
-        logE("Failed to get image from RSS: %s", e.what());
-        return retImg;
+        if(scope == SCOPE_ITEM) finishItem();
+        else if(scope == SCOPE_IMAGE) finishImage();
+        scope = SCOPE_NONE;
     }
+    else if(depth == 2 && inChannel && format != FORMAT_ATOM) inChannel = false; //Only the first channel is read
 
-    retImg.filled = true; //If no errors were thrown at all, set the filled attribute to true on the image
-    return retImg;
-    
+    --depth;
 }
 
-void RssImage::loadImgFromUrl(const std::string t_url)
+void RssStreamParser::text(std::string_view text)
 {
-    //Make a GET request for the image data to load from the enclosure URL
-    cpr::Response imgResp = cpr::Get(cpr::Url{t_url},
-                                    cpr::Timeout(5000)                                     
-                                    ); 
-    //Log any errors that occur from getting the image
-    if(imgResp.error.code != cpr::ErrorCode::OK) throw std::runtime_error(std::string("HTTP GET request for image failed! EC: ") + std::to_string((unsigned int)imgResp.error.code) + " Reason: " + imgResp.error.message);
-    
-    FILE* tmp = fopen("cache", "wb"); //Open the image cache file in write mode
-    fwrite(imgResp.text.data(), 1, imgResp.text.size(), tmp); //Write the image data to a cache file
-    fclose(tmp); //Close the cache file
-
-    unsigned char* imgDat = stbi_load("cache", &width, &height, &ch, 4); //Re load the image data from the cache file
-    if(imgDat == NULL) throw std::runtime_error("Failed to load image data from cache file!"); //Throw an error if stb_image somehow fails
+    if(field == NULL) return;
+    if(field->inner) //Join all of the text inside of the element
+    {
+        field->text.append(text.data(), text.size());
+        field->hasText = true;
+        return;
+    }
+    if(depth != fieldDepth || field->hasText) return; //Only the first text directly inside of a field is read
+    field->text.assign(text.data(), text.size());
+    field->hasText = true;
+}
 
-    glGenTextures(1, &txID); //Generate a texture ID in openGL
-    glBindTexture(GL_TEXTURE_2D, txID); 
+void RssStreamParser::finishItem(void)
+{
+    //Skip items without a required node like RssChannel::fromXML does
+    const char* missing = (!itemTitle.present) ? "title" : (!itemLink.present && format != FORMAT_ATOM) ? "link" : (!itemDescription.present && format == FORMAT_RSS) ? "description" : NULL;
+    if(missing != NULL) 
+    {
+        logE("Failed to construct item from XML: No XML node named %s found!", missing);
+        return;
+    }
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // This is required on WebGL for non power-of-two textures
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); // Same
+    RawItem raw;
+    raw.title = itemTitle.text.c_str();
+    raw.link = itemLink.text.c_str();
+    raw.description = (format == FORMAT_ATOM && !itemDescription.present) ? itemContent.text.c_str() : itemDescription.text.c_str();
+    raw.author = itemAuthor.text.c_str();
+    raw.pubDate = (format == FORMAT_ATOM && itemPubDate.text.empty()) ? itemUpdated.text.c_str() : itemPubDate.text.c_str();
+    raw.guid = itemGuid.text.c_str();
+    raw.hasEnclosure = itemHasEnclosure;
+    raw.hasEnclosureUrl = enclosureHasUrl;
+    raw.hasEnclosureType = enclosureHasType;
+    raw.enclosureUrl = enclosureUrl.c_str();
+    raw.enclosureType = enclosureType.c_str();
+
+    addItem(channel, raw, previousItems, reused);
+}
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, imgDat); //Generate an OpenGL texture using the image data
-    
-    stbi_image_free(imgDat); //No memory leaks here 
+void RssStreamParser::finishImage(void)
+{
+    if(!imageTitle.present || !imageUrl.present)
+    {
+        logE("Failed to get image from RSS: No XML node named %s found!", imageTitle.present ? "url" : "title");
+        return;
+    }
 
-    filled = true; //We filled this image with data, so set it 
+    RssImage& img = channel.image;
+    img.title = storeText(*channel.arena, imageTitle.text.c_str());
+    img.url = storeText(*channel.arena, imageUrl.text.c_str());
+    img.description = storeText(*channel.arena, imageDescription.text.c_str());
+    if(imageWidth.present) img.width = (int)std::strtoul(imageWidth.text.c_str(), NULL, 10);
+    if(imageHeight.present) img.height = (int)std::strtoul(imageHeight.text.c_str(), NULL, 10);
+    img.filled = true;
 }
 
-RssImage RssImage::fromXMLEnclosure(const pugi::xml_node& xmlNode)
+void RssChannel::sortByDate(void)
 {
-    RssImage retImg; //The constructed RSS image object 
+    byDate.resize(items.size());
+    for(uint32_t i = 0; i < byDate.size(); ++i) byDate[i] = i;
 
-    try
+    //Stable so items with the same date, and items without one, stay in feed order
+    std::stable_sort(byDate.begin(), byDate.end(), [this](uint32_t a, uint32_t b) -> bool 
     {
-        std::string contentType = ""; //The content type specified by the enclosure node
-        contentType = REQUIREATTRIB(xmlNode, "type").as_string(); //Get the content type, hoping for image
-        if(contentType.compare(0, strlen("image/"), "image/") != 0) //If the content type is not an image, throw an error and exit
-        {
-            throw std::runtime_error( ("Enclosure found in RSS item, but it is an unsupported content type: " + contentType).c_str() );
-        }
+        int64_t dateA = items[a].published, dateB = items[b].published;
+        if(dateA == 0 || dateB == 0) return dateA != 0 && dateB == 0; //Items without a date go last
+        return dateA > dateB;
+    });
+}
 
+size_t RssChannel::countSince(int64_t since) const
+{
+    //byDate is sorted newest first, so the items published since are all before the first older one
+    auto end = std::partition_point(byDate.begin(), byDate.end(), [this, since](uint32_t i) -> bool 
+    {
+        return items[i].published != 0 && items[i].published >= since;
+    });
+    return (size_t)(end - byDate.begin());
+}
 
-        retImg.title = "Attachment";
-        retImg.url = REQUIREATTRIB(xmlNode, "url").as_string(); //Get the required URL of the image
-    }
-    catch(const std::exception& e) //Catch any REQUIRENODE errors and return the bad image struct 
+size_t RssChannel::nextRefresh(size_t defaultTtl) const
+{
+    size_t due = lastChecked + std::max<size_t>((ttl > 0) ? ttl : defaultTtl, 1); //Never due again in the same minute
+    for(size_t i = 0; i < 24 * 7; ++i) //A week of hours is every combination of skipped hours and days
     {
-        logW("%s", e.what());
-        return retImg; 
+        size_t hour = (due / 60) % 24;
+        size_t day = (due / (60 * 24) + 4) % 7; //1970-01-01 was a Thursday
+        if( (skipHours & (1u << hour)) == 0 && (skipDays & (1u << day)) == 0) return due;
+        due = (due / 60 + 1) * 60; //Try the start of the next hour
     }
+    return due; //Every hour is skipped, so refresh anyway
+}
 
-    //Note: filled is not set for the image here, because it is explicitly set when we later call loadImgFromUrl
-    return retImg;
+/**
+ * @brief Function to get the current time in the units of RssChannel::lastChecked
+ * 
+ * @return size_t Minutes since 1970
+ */
+static size_t minutesNow(void)
+{
+    return std::chrono::duration_cast<std::chrono::minutes>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief The first line of the record file, records written before HTTP
+ * validators were saved have no header
+ */
+static const char* RECORD_HEADER = "#GoodNews record v3";
+static const char* RECORD_HEADER_V2 = "#GoodNews record v2"; //Records from before failures were saved
+
+static const char* SNAPSHOT_PATH = "cached/channels.snap"; //The binary snapshot of every channel, written with the record
+
+RssFeedManager::RssFeedManager(void)
+{
+    recordFile.open("subscribed.txt", std::ios::app | std::ios_base::out | std::ios_base::in); //Open the subscribed channels list in append, not truncate mode
 }
 
-RssItem RssItem::fromXML(const pugi::xml_node& xmlNode)
+RssFeedManager::~RssFeedManager()
 {
-    RssItem retItem; //The returned RSS item object constructed from XML
+    stopRefreshing(); //Don't publish channels while the record is being written
+    writeRecord(); //Write all records to the file
+}
 
-    try
-    {
-        if(xmlNode.empty()) throw std::runtime_error("Attempted to construct an RSS item from an empty XML node"); //Make sure the XML node exists
+std::shared_ptr<const RssChannelList> RssFeedManager::snapshot(void) const
+{
+    return std::atomic_load(&channels);
+}
+
+void RssFeedManager::publish(std::shared_ptr<const RssChannelList> list)
+{
+    std::atomic_store(&channels, list);
 
-        retItem.title = REQUIRENODE(xmlNode, "title").text().as_string(); //Get the required title of the RSS item
-        retItem.link = REQUIRENODE(xmlNode, "link").text().as_string();   //Get the required link to the RSS item
-        retItem.description = REQUIRENODE(xmlNode, "description").text().as_string(); //Get the required description of the RSS item
+    {
+        std::lock_guard<std::mutex> lock(refreshMutex);
+        std::unordered_map<std::string, RefreshTimes> times; //Only channels in the new list stay scheduled
+        for(const auto& ch : *list)
+        {
+            size_t due = std::max(ch->nextRefresh(defaultTtl), retryAtOf(ch->link)); //Failing channels wait for their backoff
+            auto old = refreshTimes.find(ch->link);
+            if(old != refreshTimes.end() && old->second.channelDue == due) //The channel wasn't refreshed, keep when it is scheduled
+            {
+                times[ch->link] = old->second;
+                continue;
+            }
+            times[ch->link] = RefreshTimes{due, due};
+            refreshQueue.push(DueRefresh{due, ch->link});
+        }
+        for(const RecordEntry& entry : unloadedEntries) //Feeds that failed to load are tried again when their backoff is over
+        {
+            size_t due = retryAtOf(entry.url);
+            auto old = refreshTimes.find(entry.url);
+            if(old != refreshTimes.end() && old->second.channelDue == due)
+            {
+                times[entry.url] = old->second;
+                continue;
+            }
+            times[entry.url] = RefreshTimes{due, due};
+            refreshQueue.push(DueRefresh{due, entry.url});
+        }
+        refreshTimes.swap(times);
+    }
+    refreshWake.notify_all(); //The earliest due channel may have changed
 
+    if(onPublish) onPublish(); //Let readers know there is a new list
+}
 
+size_t RssFeedManager::recordFailure(const std::string& link)
+{
+    thread_local std::mt19937 random(std::random_device{}()); //Each thread jitters on its own so no lock is needed
 
-        retItem.author = xmlNode.child("author").text().as_string(); //Get the optional author of the item
-        retItem.enclosure = RssImage::fromXMLEnclosure(xmlNode.child("enclosure") ); //Get the optional attachment for the item
-        retItem.pubDate = xmlNode.child("pubDate").text().as_string(); //Get the optional publication date of the item
+    std::lock_guard<std::mutex> lock(healthMutex);
+    FeedHealth& health = feedHealth[link];
+    health.failures++;
 
-        cleanHTML(retItem.description); //Strip any HTML tags from the item desciption
-        cleanHTML(retItem.title);
-        
+    size_t delay; //Minutes until the feed may be tried again
+    if(health.failures >= circuitThreshold) //The circuit is open, only try the feed now and then to see if it came back
+    {
+        delay = circuitOpenDelay;
+        if(health.failures == circuitThreshold) logW("RSS feed %s failed %zu times in a row, only trying it every %zu minutes", link.c_str(), health.failures, circuitOpenDelay);
     }
-    catch(const std::exception& e) //Propogate any error upwards to the caller if a required field is missing
+    else
     {
-        throw e;
+        delay = std::min(backoffBase << std::min<size_t>(health.failures - 1, 20), maxBackoff); //Double the wait after every failure
     }
 
-    return retItem;
+    std::uniform_real_distribution<double> jitter(0.75, 1.25); //Spread out feeds that failed together so they aren't retried together
+    health.retryAt = minutesNow() + std::max<size_t>((size_t)(delay * jitter(random)), 1);
+    return health.retryAt;
 }
 
-RssChannel RssChannel::fromXML(const pugi::xml_document& xmlDoc, const std::string link)
+void RssFeedManager::recordSuccess(const std::string& link)
 {
-    if(xmlDoc.empty()) throw std::runtime_error("Attempted to parse an empty XML document!"); //Throw an error if the XML node is not valid
+    std::lock_guard<std::mutex> lock(healthMutex);
+    auto health = feedHealth.find(link);
+    if(health == feedHealth.end()) return;
 
-    RssChannel retChannel; //The constructed RSS channel object to return
-    pugi::xml_node channelNode; //The pugixml channel item node
+    if(health->second.failures >= circuitThreshold) logI("RSS feed %s is working again after %zu failures", link.c_str(), health->second.failures);
+    feedHealth.erase(health);
+}
 
-    
-    try
+size_t RssFeedManager::retryAtOf(const std::string& link)
+{
+    std::lock_guard<std::mutex> lock(healthMutex);
+    auto health = feedHealth.find(link);
+    return (health == feedHealth.end()) ? 0 : health->second.retryAt;
+}
+
+void RssFeedManager::startRefreshing(void)
+{
+    std::lock_guard<std::mutex> lock(refreshMutex);
+    if(refreshRunning) return;
+
+    refreshRunning = true;
+    refreshThread = std::thread(&RssFeedManager::refreshLoop, this);
+}
+
+void RssFeedManager::stopRefreshing(void)
+{
     {
-        channelNode = REQUIRENODE( REQUIRENODE(xmlDoc, "rss"), "channel"); //Require the RSS channel node 
+        std::lock_guard<std::mutex> lock(refreshMutex);
+        refreshRunning = false;
+    }
+    refreshWake.notify_all();
+    if(refreshThread.joinable()) refreshThread.join();
+}
 
-        retChannel.title = REQUIRENODE(channelNode, "title").text().as_string(); //Get the title string of the RSS channel
-        retChannel.description = REQUIRENODE(channelNode, "description").text().as_string(); //Get the description of the RSS channel
-        retChannel.link = link; //Set the source URL for this channel
+void RssFeedManager::refreshLoop(void)
+{
+    std::unique_lock<std::mutex> lock(refreshMutex);
+    while(refreshRunning)
+    {
+        size_t now = minutesNow();
+        std::vector<std::string> due; //Every channel that is due now
+        while(!refreshQueue.empty() && refreshQueue.top().due <= now)
+        {
+            DueRefresh top = refreshQueue.top();
+            refreshQueue.pop();
 
-        //Clean up any whitespace from the title and link
-        cleanWhiteSpace(retChannel.title);
-        cleanWhiteSpace(retChannel.link);
+            auto times = refreshTimes.find(top.link);
+            if(times != refreshTimes.end() && times->second.scheduledDue == top.due) due.push_back(top.link); //Skip channels that were removed or rescheduled
+        }
 
-        retChannel.ttl = ( ( channelNode.child("ttl").empty() ) ? 0ULL : channelNode.child("ttl").text().as_ullong() ); //Get optional ttl parameter
+        if(due.empty()) //Sleep until the earliest channel is due or the queue changes
+        {
+            if(refreshQueue.empty()) refreshWake.wait(lock);
+            else refreshWake.wait_until(lock, std::chrono::system_clock::time_point(std::chrono::minutes(refreshQueue.top().due)));
+            continue;
+        }
 
-        retChannel.image = RssImage::fromXML(channelNode.child("image")); //Get the image attribute of the Rss Channel
+        lock.unlock(); //Don't block publishing while downloading
 
-        for(const pugi::xml_node& item : channelNode.children("item")) //For every item in the channel...
+        std::vector<char> failed(due.size(), 0);
+        std::atomic<size_t> nextDue(0);
+        auto worker = [&](void)
         {
-            try
-            {
-                retChannel.items.push_back(RssItem::fromXML(item)); //Attempt to make an item from the XML data and add it to the list of items
-            }
-            catch(const std::exception& e) //Catch any error creating the item and log them, don't throw them
+            for(size_t idx = nextDue++; idx < due.size(); idx = nextDue++)
             {
-                logE("Failed to construct item from XML: %s", e.what());
+                try
+                {
+                    refreshChannel(due[idx]); //Publishing the channel schedules its next refresh
+                }
+                catch(const std::exception& e)
+                {
+                    logE("Background refresh of %s failed: %s", due[idx].c_str(), e.what());
+                    failed[idx] = 1;
+                }
             }
-            
+        };
+
+        size_t workerCount = std::min(std::max<size_t>(maxConcurrentRefresh, 1), due.size());
+        std::vector<std::future<void>> workers;
+        for(size_t i = 0; i < workerCount; ++i)
+        {
+            workers.push_back(std::async(std::launch::async, worker));
+        }
+        for(auto& w : workers) w.wait();
+
+        lock.lock();
+        for(size_t idx = 0; idx < due.size(); ++idx) //Try failed channels again when their backoff is over
+        {
+            auto times = refreshTimes.find(due[idx]);
+            if(!failed[idx] || times == refreshTimes.end()) continue;
+
+            times->second.scheduledDue = std::max(retryAtOf(due[idx]), minutesNow() + 1);
+            refreshQueue.push(DueRefresh{times->second.scheduledDue, due[idx]});
         }
+    }
+}
+
+void RssFeedManager::addChannel(const std::string link)
+{
+    std::shared_ptr<const RssChannel> ch;
+    std::shared_ptr<const RssChannel> partial; //The last partial channel that was published while downloading
 
-        if(retChannel.ttl != 0) //If TTL exists, then cache this file for performance
+    //Method to put a channel in the list in place of the partial channel, or remove the partial channel if replacement is NULL.
+    //Returns false if replacement wasn't put in the list
+    auto replacePartial = [&](std::shared_ptr<const RssChannel> replacement) -> bool
+    {
+        auto list = std::make_shared<RssChannelList>(*snapshot());
+        for(const auto& match : *list) //The feed is already in the list some other way, so only the partial channel is removed
         {
-            std::string cachePath = "cached/";            //The cached XML file path
-            cachePath.append(retChannel.title);           //Append the file name  
-            cachePath.append(".rss");                     //Append the rss extension for clarity
+            if(match != partial && replacement != NULL && (match->link == link || replacement->title.compare(match->title) == 0)) replacement = NULL;
+        }
 
-            xmlDoc.save_file(cachePath.c_str());          //Cache the XML source to a file
+        auto found = std::find(list->begin(), list->end(), partial);
+        if(partial != NULL && found != list->end()) 
+        {
+            if(replacement != NULL) *found = replacement;
+            else list->erase(found);
         }
+        else if(replacement != NULL) list->push_back(replacement);
+        else return false;
+
+        partial = replacement;
+        publish(list);
+        return replacement != NULL;
+    };
 
-        //Clean RSS channel title and description of any HTML tags
-        cleanHTML(retChannel.description); 
-        cleanHTML(retChannel.title);
+    try
+    {
+        for(const auto& match : *snapshot()) 
+        {
+            if(match->link == link) //Already subscribed, so refresh the channel instead
+            {
+                refreshChannel(link);
+                return;
+            }
+        }
 
+        //Attempt to create an RSS channel from the XML document, showing the first items before the whole feed is downloaded
+        ch = std::make_shared<const RssChannel>(RssChannel::fromUrl(link, "", "", NULL, [&](const RssChannel& part)
+        {
+            std::lock_guard<std::mutex> lock(publishMutex);
+            replacePartial(std::make_shared<const RssChannel>(part));
+        })); 
     }
-    catch(const std::exception& e) //If any error was thrown by REQUIRENODE, propogate them up
+    catch(const std::exception& e) //Catch any errors thrown by the channel creation
     {
-        throw e;
+        {
+            std::lock_guard<std::mutex> lock(publishMutex);
+            replacePartial(NULL); //Don't leave half of a broken feed in the list
+        }
+        throw std::runtime_error(std::string("Failed to add RSS channel to subscribed! Reason: ") + e.what());
     }
-    
-    return retChannel;
-}   
 
-RssChannel RssChannel::fromUrl(const std::string url)
+    std::lock_guard<std::mutex> lock(publishMutex);
+    if(!replacePartial(ch)) return; //Make sure that we don't add the same RSS feed twice
+
+    unloadedEntries.erase( //The feed loaded now, so its old record entry isn't needed
+    std::remove_if(unloadedEntries.begin(), unloadedEntries.end(), [&](const RecordEntry& entry) -> bool 
+    {
+        return entry.url == link;
+    }), unloadedEntries.end());
+}
+
+void RssFeedManager::refreshChannel(const std::string link)
 {
-    cpr::Response resp = cpr::Get(cpr::Url{url}, cpr::Timeout{5000}); //Get the RSS feed from the recorded URL
-    if(resp.error.code != cpr::ErrorCode::OK) //If any error occured, throw it
+    std::shared_ptr<const RssChannel> previous; //The channel as it is now
+    for(const auto& match : *snapshot())
     {
-        throw std::runtime_error("HTTP GET request failed with error: " + resp.error.message);
+        if(match->link == link) previous = match;
     }
-
-    pugi::xml_document doc; //The document we will get from the recieved URL
-    pugi::xml_parse_result parseRes = doc.load_string(resp.text.c_str()); //Load the XML data from the recieved response
-    if(!parseRes) //If the parsing failed...
+    if(!previous) //The feed never loaded, so try to load it like a new channel
     {
-        throw std::runtime_error("Failed to parse XML recieved from " + url + "! Error: " + parseRes.description());
+        loadUnloadedEntry(link);
+        return;
     }
 
-    RssChannel rssCh;
-
+    std::shared_ptr<const RssChannel> ch;
     try
     {
-        rssCh = RssChannel::fromXML(doc, url); //Construct an RSS channel from the XML document
-        //Use wordy chrono library to get time in minutes since a known date that this feed was refreshed
-        rssCh.lastChecked = std::chrono::duration_cast<std::chrono::minutes>(std::chrono::system_clock::now().time_since_epoch()).count();
+        //Download the channel again, only parsing the items that are new or changed
+        ch = std::make_shared<const RssChannel>(RssChannel::fromUrl(link, previous->etag, previous->lastModified, previous.get()));
     }
-    catch(const std::exception& e) //Propogate any errors up
+    catch(const std::exception& e)
     {
-        throw e;
+        recordFailure(link); //Back off before the next background refresh
+        throw;
     }
-    
+    recordSuccess(link);
 
-    logI("Loaded RSS feed from URL %s", url.c_str());
-    return rssCh;
+    std::lock_guard<std::mutex> lock(publishMutex);
+    auto list = std::make_shared<RssChannelList>(*snapshot()); //Copy the current list and replace the channel in the copy
+    for(auto& match : *list)
+    {
+        if(match->link == link) 
+        {
+            match = ch;
+            publish(list);
+            return;
+        }
+    }
+    //The channel was removed while it was downloading, so don't add it back
 }
 
-RssFeedManager::RssFeedManager(void)
+void RssFeedManager::loadUnloadedEntry(const std::string& link)
 {
-    recordFile.open("subscribed.txt", std::ios::app | std::ios_base::out | std::ios_base::in); //Open the subscribed channels list in append, not truncate mode
+    RecordEntry entry; //The record entry of the feed
+    {
+        std::lock_guard<std::mutex> lock(publishMutex);
+        auto found = std::find_if(unloadedEntries.begin(), unloadedEntries.end(), [&](const RecordEntry& e) { return e.url == link; });
+        if(found == unloadedEntries.end()) throw std::runtime_error("Not subscribed to RSS channel " + link);
+        entry = *found;
+    }
+
+    std::shared_ptr<const RssChannel> ch;
+    try
+    {
+        ch = std::make_shared<const RssChannel>(RssChannel::fromUrl(link, entry.etag, entry.lastModified));
+    }
+    catch(const std::exception& e)
+    {
+        recordFailure(link); //Back off again before the next try
+        throw;
+    }
+    recordSuccess(link);
+    logI("Loaded RSS feed '%s' from %s after it failed to load at startup", entry.title.c_str(), link.c_str());
+
+    std::lock_guard<std::mutex> lock(publishMutex);
+    auto found = std::find_if(unloadedEntries.begin(), unloadedEntries.end(), [&](const RecordEntry& e) { return e.url == link; });
+    if(found == unloadedEntries.end()) return; //The feed was removed or added some other way while it was downloading
+    unloadedEntries.erase(found);
+
+    auto list = std::make_shared<RssChannelList>(*snapshot());
+    list->push_back(ch);
+    publish(list); //Also stops scheduling the feed as an unloaded entry
 }
 
-RssFeedManager::~RssFeedManager()
+void RssFeedManager::removeChannel(const std::string title)
 {
-    writeRecord(); //Write all records to the file
+    std::lock_guard<std::mutex> lock(publishMutex);
+    auto list = std::make_shared<RssChannelList>(*snapshot()); //Copy the current list and remove the channel from the copy
+
+    //Remove an element from the list if the title matches the title given
+    list->erase(
+    std::remove_if(list->begin(), list->end(), [&](const std::shared_ptr<const RssChannel>& ch) -> bool 
+    {
+        if(ch->title.compare(title) == 0) return true;
+        else                             return false;
+    }), list->end());
+
+    unloadedEntries.erase(
+    std::remove_if(unloadedEntries.begin(), unloadedEntries.end(), [&](const RecordEntry& entry) -> bool 
+    {
+        return entry.title.compare(title) == 0;
+    }), unloadedEntries.end());
+
+    publish(list);
 }
 
-void RssFeedManager::addChannel(const std::string link)
+bool RssFeedManager::loadRecordEntry(const RecordEntry& entry, const RssSnapshot* snapshot, RssChannel& out)
 {
-    try
+    const std::string& title = entry.title;
+    const std::string& url = entry.url;
+    size_t ttl = entry.ttl;
+    size_t lastUpdate = entry.lastUpdate;
+
+    size_t thisMinute = minutesNow(); //Get how many minutes have passed since epoch
+    bool backingOff = entry.retryAt > thisMinute; //The feed failed recently, so don't spend a timeout on it yet
+    bool downloadFailed = false; //If the feed was already tried this time
+
+    if( (thisMinute - lastUpdate) > ttl && !backingOff) //If we need to refresh the RSS feed, get it from the URL
     {
-        RssChannel ch = RssChannel::fromUrl(link); //Attempt to create an RSS channel from the XML document
-        for(RssChannel& match : channels) //Make sure that we don't add the same RSS feed twice
+        RssChannel previous; //The channel as it was last checked, so only new or changed items need parsing
+        bool hasPrevious = snapshot != NULL && snapshot->find(url, lastUpdate, previous);
+        try
         {
-            if(ch.title.compare(match.title) == 0) return; 
+            out = RssChannel::fromUrl(url, entry.etag, entry.lastModified, hasPrevious ? &previous : NULL); //Attempt to construct an RSS channel from the URL, reusing the cache if it wasn't modified
+            recordSuccess(url);
+            logI("Downloaded RSS feed %s from %s", title.c_str(), url.c_str());
+            return true;
+        }
+        catch(const std::exception& e) //Catch any bad XML parsing errors
+        {
+            size_t retryAt = recordFailure(url);
+            logE("Error loading channel from %s! Error: %s, not trying again for %zu minutes", url.c_str(), e.what(), retryAt - thisMinute);
+            downloadFailed = true;
         }
-        channels.push_back(ch);                     //Add the channel to our list if it was created 
 
+        if(hasPrevious) //Show the channel as it was last checked instead of nothing
+        {
+            out = std::move(previous);
+            logW("Using the last loaded copy of RSS channel \'%s\'", title.c_str());
+            return true;
+        }
     }
-    catch(const std::exception& e) //Catch any errors thrown by the channel creation
+    else if(backingOff)
     {
-        throw std::runtime_error(std::string("Failed to add RSS channel to subscribed! Reason: ") + e.what());
+        logW("RSS feed \'%s\' failed %zu times in a row, not downloading it for %zu more minutes", title.c_str(), entry.failures, entry.retryAt - thisMinute);
+    }
+    else
+    {
+        logI("RSS feed \'%s\' TTL is %zu, it has been %zu minutes since the feed was last checked", title.c_str(), ttl, thisMinute - lastUpdate); //Log how long the cached feed has gone without an update
     }
-}
 
-void RssFeedManager::removeChannel(const std::string title)
-{
-    //Remove an element from the list if the title matches the title given
-    channels.erase(
-    std::remove_if(channels.begin(), channels.end(), [&](const RssChannel& ch) -> bool 
+    if(snapshot != NULL && snapshot->find(url, lastUpdate, out)) //The snapshot has the channel as it was last checked, so nothing needs parsing
     {
-        if(ch.title.compare(title) == 0) return true;
-        else                             return false;
-    }), channels.end());
+        logI("RSS channel \'%s\' loaded from channel snapshot", title.c_str());
+        return true;
+    }
+
+    try
+    {
+        out = RssChannel::fromCache(url); //Make the rss channel from the cached XML document
+        out.lastChecked = lastUpdate; //Keep the old last checked timestamp and validators after loading from the cache
+        out.etag = entry.etag;
+        out.lastModified = entry.lastModified;
+
+        logI("RSS channel \'%s\' loaded from cached RSS file \'%s\'", title.c_str(), cachePathFor(url).c_str());
+    }
+    catch(const std::exception& e) //Catch any channel construction errors
+    {
+        if(downloadFailed || backingOff) //Don't try the URL again when it is failing
+        {
+            logE("Failed to load cached RSS file for \'%s\' while the feed is failing; error: \'%s\'", title.c_str(), e.what());
+            return false;
+        }
+
+        logW("Failed to load cached RSS file for \'%s\'; error: \'%s\', falling back to URL...", title.c_str(), e.what());
+        try //Try to download the RSS feed instead
+        { 
+            out = RssChannel::fromUrl(url); //Attempt to load the channel from url
+            recordSuccess(url);
+        }
+        catch(const std::exception& e) //Catch any channel construction errors
+        {
+            recordFailure(url);
+            logE("Failed to load RSS channel from URL %s after failing to load cache file!", e.what());
+            return false; //Continue to next item in the record 
+        }
+
+        logI("Downloaded \'%s\' RSS feed from %s after failing to load cached XML", title.c_str(), url.c_str());
+    }
+
+    return true;
 }
 
 void RssFeedManager::loadChannelsFromRecord(void)
@@ -329,98 +1796,82 @@ void RssFeedManager::loadChannelsFromRecord(void)
     recordFile.seekg(0); //Return to line 0 of the file
     std::string line; //Read line of the record file
 
+    std::getline(recordFile, line); //Check for the record version header
+    bool hasFailures = (line == RECORD_HEADER); //Records before v3 don't have failure counts
+    bool hasValidators = hasFailures || (line == RECORD_HEADER_V2); //Old records without a header don't have HTTP validators
+    if(!hasValidators) recordFile.seekg(0); //Old records start with the first entry
+
+    std::vector<RecordEntry> entries; //Every entry in the record, in file order
     while(!recordFile.eof()) //Get every channel in the file
     {
         char *badChar; //The character that a strin to size_t conversion failed on
+        RecordEntry entry; 
 
-        std::string title; //Title read from the record
-        std::string url;   //URL of the RSS feed
-        size_t ttl;        //Time to live of the RSS feed
-        size_t lastUpdate; //The last updated time in minutes
-
-        std::getline(recordFile, title);
-        if(title.empty()) break; //Don't read final newline as another entry
+        std::getline(recordFile, entry.title);
+        if(entry.title.empty()) break; //Don't read final newline as another entry
         
-        std::getline(recordFile, url);
+        std::getline(recordFile, entry.url);
 
         std::getline(recordFile, line); //Get ttl line in file
-        ttl = std::strtoull(line.c_str(), &badChar, 10); //Convert the read string to a size_t
+        entry.ttl = std::strtoull(line.c_str(), &badChar, 10); //Convert the read string to a size_t
         std::getline(recordFile, line);
-        lastUpdate = std::strtoull(line.c_str(), &badChar, 10); //Conver the last update minutes to a size_t
+        entry.lastUpdate = std::strtoull(line.c_str(), &badChar, 10); //Conver the last update minutes to a size_t
 
-        size_t thisMinute = std::chrono::duration_cast<std::chrono::minutes>(std::chrono::system_clock::now().time_since_epoch()).count(); //Get how many minutes have passed since epoch
-        if( (thisMinute - lastUpdate) > ttl) //If we need to refresh the RSS feed, get it from the URL
+        if(hasValidators) //Get the ETag and Last-Modified lines, which may be empty
         {
-            try
-            {
-                channels.push_back(RssChannel::fromUrl(url)); //Attempt to construct an RSS channel from the URL
-            }
-            catch(const std::exception& e) //Catch any bad XML parsing errors
-            {
-                logE("Error loading channel from %s! Error: %s", url.c_str(), e.what());
-                continue; //Continue to next channel in the record
-            }
-            logI("Downloaded RSS feed %s from %s", title.c_str(), url.c_str());
+            std::getline(recordFile, entry.etag);
+            std::getline(recordFile, entry.lastModified);
         }
-        else //Use a cached RSS file if the ttl duration hasn't passed
+        if(hasFailures) //Get how often the feed failed and when it can be tried again
         {
-            logI("RSS feed \'%s\' TTL is %zu, it has been %zu minutes since the feed was last checked", title.c_str(), ttl, thisMinute - lastUpdate); //Log how long the cached feed has gone without an update
-            std::string cachePath = "cached/"; //The cached XML file path
-            cachePath.append(title);           //Append the file name  
-            cachePath.append(".rss");          //Append the rss extension for clarity
-
-            pugi::xml_document doc; //The xml document to load the cache from
-            pugi::xml_parse_result res = doc.load_file(cachePath.c_str()); //Load the XML file from the cache
-            if(!res) //If the XML parsing failed...
-            {
-                //Log the error 
-                logW("Failed to parse cached XML file from %s; error %s, attempting to load from URL instead...", cachePath.c_str(), res.description());
-                try //Try to download the RSS feed instead
-                { 
-                    channels.push_back(RssChannel::fromUrl(url)); //Attempt to load the channel from url
-                }
-                catch(const std::exception& e) //Catch any channel construction errors
-                {
-                    logE("Failed to load RSS channel from URL %s after failing to load cache file!", e.what());
-                    continue; //Continue to next item in the record 
-                }
+            std::getline(recordFile, line);
+            entry.failures = std::strtoull(line.c_str(), &badChar, 10);
+            std::getline(recordFile, line);
+            entry.retryAt = std::strtoull(line.c_str(), &badChar, 10);
+        }
 
-                logI("Downloaded \'%s\' RSS feed from \'%s\' after failing to load cached XML", title.c_str(), url.c_str());
-            }
-            else
-            {
-                try
-                {
-                    channels.push_back(RssChannel::fromXML(doc, url)); //Make the rss channel from the XML document loaded
-                    channels.back().lastChecked = lastUpdate; //Keep the old last checked timestamp after loading from XML
+        entries.push_back(entry);
+    }
 
-                    logI("RSS channel \'%s\' loaded from cached RSS file \'%s\'", title.c_str(), cachePath.c_str());
-                }
-                catch(const std::exception& e) //Catch any channel construction errors
-                {
-                    logW("Failed to parse cached XML file at \'%s\'; error: \'%s\', falling back to URL...", cachePath.c_str(), e.what());
-                    try //Try to download the RSS feed instead
-                    { 
-                        channels.push_back(RssChannel::fromUrl(url)); //Attempt to load the channel from url
-                    }
-                    catch(const std::exception& e) //Catch any channel construction errors
-                    {
-                        logE("Failed to load RSS channel from URL %s after failing to load cache file!", e.what());
-                        continue; //Continue to next item in the record 
-                    }
+    {
+        std::lock_guard<std::mutex> lock(healthMutex);
+        for(const RecordEntry& entry : entries) feedHealth[entry.url] = FeedHealth{entry.failures, entry.retryAt};
+    }
 
-                    logI("Downloaded \'%s\' RSS feed from %s after failing to load cached XML", title.c_str(), url.c_str());
-                }
+    recordFile.close();
+    recordFile.open("subscribed.txt", std::ios::app | std::ios_base::out | std::ios_base::in);
 
+    RssSnapshot channelSnapshot; //Channels as they were when the program last closed
+    const RssSnapshot* snapshotPtr = channelSnapshot.open(SNAPSHOT_PATH) ? &channelSnapshot : NULL;
 
-            }
+    std::vector<RssChannel> loaded(entries.size()); //One slot per record entry so results keep record order
+    std::vector<char> succeeded(entries.size(), 0); //If the channel in the same slot was loaded
+    std::atomic<size_t> nextEntry(0);               //The next record entry that a worker should pick up
 
+    auto worker = [&](void) //Each worker keeps taking the next entry until all are loaded
+    {
+        for(size_t idx = nextEntry++; idx < entries.size(); idx = nextEntry++)
+        {
+            succeeded[idx] = loadRecordEntry(entries[idx], snapshotPtr, loaded[idx]);
         }
-        
+    };
+
+    size_t workerCount = std::min(std::max<size_t>(maxConcurrentRefresh, 1), entries.size()); //Don't start more workers than there are feeds
+    std::vector<std::future<void>> workers;
+    for(size_t i = 0; i < workerCount; ++i)
+    {
+        workers.push_back(std::async(std::launch::async, worker));
     }
+    for(auto& w : workers) w.wait(); //Wait for every feed to finish loading
 
-    recordFile.close();
-    recordFile.open("subscribed.txt", std::ios::app | std::ios_base::out | std::ios_base::in);
+    std::lock_guard<std::mutex> lock(publishMutex);
+    auto list = std::make_shared<RssChannelList>(*snapshot());
+    for(size_t idx = 0; idx < entries.size(); ++idx) //Merge the loaded channels in record order
+    {
+        if(succeeded[idx]) list->push_back(std::make_shared<const RssChannel>(std::move(loaded[idx])));
+        else unloadedEntries.push_back(entries[idx]); //Keep failing feeds in the record so they are tried again later
+    }
+    publish(list); //Show every loaded channel at once
 }
 
 void RssFeedManager::writeRecord(void)
@@ -428,11 +1879,24 @@ void RssFeedManager::writeRecord(void)
     recordFile.close();
     recordFile.open("subscribed.txt", std::ios::trunc | std::ios::out); //Reopen the record file in write mode
 
-    for(auto& ch : channels) //For every channel, write it's last checked date
+    std::lock_guard<std::mutex> publishLock(publishMutex); //For the unloaded entries
+    std::lock_guard<std::mutex> healthLock(healthMutex);
+    recordFile << RECORD_HEADER << "\n"; //Write the record version so validators and failures can be read back
+    for(const auto& ch : *snapshot()) //For every channel, write it's last checked date
+    {
+        const FeedHealth& health = feedHealth[ch->link];
+        recordFile << ch->title << "\n" << ch->link << "\n" << ch->ttl << "\n" << ch->lastChecked << "\n" << ch->etag << "\n" << ch->lastModified << "\n"
+                   << health.failures << "\n" << health.retryAt << std::endl; //Record this channel in our list of subscribed
+    }
+    for(const RecordEntry& entry : unloadedEntries) //Feeds that failed to load keep their entry as it was, with the new failure count
     {
-        recordFile << ch.title << "\n" << ch.link << "\n" << ch.ttl << "\n" << ch.lastChecked << std::endl; //Record this channel in our list of subscribed
+        const FeedHealth& health = feedHealth[entry.url];
+        recordFile << entry.title << "\n" << entry.url << "\n" << entry.ttl << "\n" << entry.lastUpdate << "\n" << entry.etag << "\n" << entry.lastModified << "\n"
+                   << health.failures << "\n" << health.retryAt << std::endl;
     }
 
     recordFile.close();
+
+    if(!RssSnapshot::write(SNAPSHOT_PATH, *snapshot())) logW("Failed to write channel snapshot to %s", SNAPSHOT_PATH);
 }
 
@@ -0,0 +1,267 @@
+#include "include/snapshot.hpp"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const uint32_t SNAPSHOT_VERSION = 5; //Increase whenever the record layout changes, old snapshots are then ignored
+static const char SNAPSHOT_MAGIC[8] = {'G', 'N', 'S', 'N', 'A', 'P', 0, 0};
+
+static_assert(sizeof(RssSnapshot::ChannelRecord) % 8 == 0, "Channel records must keep the 8 byte alignment of the records after them");
+static_assert(sizeof(RssSnapshot::ItemRecord) % 8 == 0, "Item records must keep the 8 byte alignment of the string table");
+static_assert(sizeof(RssSnapshot::Header) % 8 == 0, "The header must keep the records after it aligned");
+
+RssMappedFile::RssMappedFile(const std::string& path)
+{
+    #ifdef _WIN32
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(fileHandle == INVALID_HANDLE_VALUE)
+    {
+        fileHandle = NULL;
+        return;
+    }
+
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) return;
+
+    mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(mappingHandle == NULL) return;
+
+    data = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if(data != NULL) size = (size_t)fileSize.QuadPart;
+    #else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) return;
+
+    struct stat st;
+    if(fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void* mapped = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapped != MAP_FAILED)
+        {
+            data = (const char*)mapped;
+            size = (size_t)st.st_size;
+        }
+    }
+    ::close(fd); //The mapping stays valid after the file is closed
+    #endif
+}
+
+RssMappedFile::~RssMappedFile()
+{
+    #ifdef _WIN32
+    if(data != NULL) UnmapViewOfFile(data);
+    if(mappingHandle != NULL) CloseHandle(mappingHandle);
+    if(fileHandle != NULL) CloseHandle(fileHandle);
+    #else
+    if(data != NULL) munmap((void*)data, size);
+    #endif
+}
+
+/**
+ * @brief Class that builds the string table of a snapshot
+ * 
+ */
+struct StringTableWriter
+{
+    std::string table; //Every string, one after another
+
+    RssSnapshot::StrRef add(std::string_view str)
+    {
+        RssSnapshot::StrRef ref = { (uint32_t)table.size(), (uint32_t)str.size() };
+        table.append(str);
+        table.push_back('\0'); //Null terminate every string so views into the mapped file are C strings
+        return ref;
+    }
+
+    RssSnapshot::ImageRecord add(const RssImage& img)
+    {
+        RssSnapshot::ImageRecord rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.title = add(img.title);
+        rec.url = add(img.url);
+        rec.description = add(img.description);
+        rec.width = img.width;
+        rec.height = img.height;
+        rec.filled = img.filled;
+        return rec;
+    }
+};
+
+bool RssSnapshot::write(const std::string& path, const RssChannelList& channels)
+{
+    StringTableWriter strings;
+    std::vector<ChannelRecord> channelRecs;
+    std::vector<ItemRecord> itemRecs;
+    channelRecs.reserve(channels.size());
+
+    for(const auto& ch : channels)
+    {
+        ChannelRecord rec;
+        memset(&rec, 0, sizeof(rec)); //Don't write uninitialized padding to the file
+        rec.title = strings.add(ch->title);
+        rec.description = strings.add(ch->description);
+        rec.link = strings.add(ch->link);
+        rec.etag = strings.add(ch->etag);
+        rec.lastModified = strings.add(ch->lastModified);
+        rec.image = strings.add(ch->image);
+        rec.ttl = ch->ttl;
+        rec.skipHours = ch->skipHours;
+        rec.skipDays = ch->skipDays;
+        rec.lastChecked = ch->lastChecked;
+        rec.firstItem = itemRecs.size();
+        rec.itemCount = ch->items.size();
+
+        for(const RssItem& item : ch->items)
+        {
+            ItemRecord itemRec;
+            memset(&itemRec, 0, sizeof(itemRec));
+            itemRec.title = strings.add(item.title);
+            itemRec.description = strings.add(item.description);
+            itemRec.link = strings.add(item.link);
+            itemRec.pubDate = strings.add(item.pubDate);
+            itemRec.author = strings.add(item.author);
+            itemRec.guid = strings.add(item.guid);
+            itemRec.enclosure = strings.add(item.enclosure);
+            itemRec.contentHash = item.contentHash;
+            itemRec.published = item.published;
+            itemRecs.push_back(itemRec);
+        }
+        channelRecs.push_back(rec);
+    }
+
+    if(strings.table.size() > UINT32_MAX) return false; //String offsets are 32 bit
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = 0x01020304;
+    header.channelCount = channelRecs.size();
+    header.itemCount = itemRecs.size();
+    header.stringBytes = strings.table.size();
+    header.channelOffset = sizeof(Header);
+    header.itemOffset = header.channelOffset + channelRecs.size() * sizeof(ChannelRecord);
+    header.stringOffset = header.itemOffset + itemRecs.size() * sizeof(ItemRecord);
+
+    //Put the whole file together in memory so it can be written in one go
+    std::string buffer;
+    buffer.reserve(header.stringOffset + strings.table.size());
+    buffer.append((const char*)&header, sizeof(header));
+    buffer.append((const char*)channelRecs.data(), channelRecs.size() * sizeof(ChannelRecord));
+    buffer.append((const char*)itemRecs.data(), itemRecs.size() * sizeof(ItemRecord));
+    buffer.append(strings.table);
+
+    return writeFileAtomic(path, buffer.data(), buffer.size());
+}
+
+bool RssSnapshot::open(const std::string& path)
+{
+    file = std::make_shared<RssMappedFile>(path);
+    if(!file->valid() || file->size < sizeof(Header)) return false;
+
+    header = (const Header*)file->data;
+    if(memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header->version != SNAPSHOT_VERSION || header->byteOrder != 0x01020304)
+    {
+        logW("Ignoring channel snapshot %s, it was written by a different version", path.c_str());
+        return false;
+    }
+
+    //Make sure every table is inside of the file before trusting any records. Each count is checked against
+    //the space left in the file before it is multiplied, so a damaged count can't wrap around to a valid offset
+    size_t size = file->size;
+    if(header->channelOffset != sizeof(Header) ||
+       header->channelCount > (size - header->channelOffset) / sizeof(ChannelRecord) ||
+       header->itemOffset != header->channelOffset + header->channelCount * sizeof(ChannelRecord) ||
+       header->itemCount > (size - header->itemOffset) / sizeof(ItemRecord) ||
+       header->stringOffset != header->itemOffset + header->itemCount * sizeof(ItemRecord) ||
+       header->stringBytes != size - header->stringOffset)
+    {
+        logW("Ignoring channel snapshot %s, the file is damaged", path.c_str());
+        return false;
+    }
+
+    channelRecs = (const ChannelRecord*)(file->data + header->channelOffset);
+    itemRecs = (const ItemRecord*)(file->data + header->itemOffset);
+    strings = file->data + header->stringOffset;
+
+    byLink.clear();
+    for(size_t i = 0; i < header->channelCount; ++i)
+    {
+        const ChannelRecord& rec = channelRecs[i];
+        if(rec.firstItem > header->itemCount || rec.itemCount > header->itemCount - rec.firstItem) continue; //Skip channels with items outside of the file
+        byLink[str(rec.link)] = i;
+    }
+    return true;
+}
+
+std::string RssSnapshot::str(const StrRef& ref) const
+{
+    if((uint64_t)ref.offset + ref.length > header->stringBytes) return std::string();
+    return std::string(strings + ref.offset, ref.length);
+}
+
+std::string_view RssSnapshot::view(const StrRef& ref) const
+{
+    if((uint64_t)ref.offset + ref.length >= header->stringBytes || strings[ref.offset + ref.length] != '\0') return std::string_view("");
+    return std::string_view(strings + ref.offset, ref.length);
+}
+
+RssImage RssSnapshot::image(const ImageRecord& rec) const
+{
+    RssImage img;
+    img.title = view(rec.title);
+    img.url = view(rec.url);
+    img.description = view(rec.description);
+    img.width = rec.width;
+    img.height = rec.height;
+    img.filled = rec.filled != 0;
+    return img;
+}
+
+bool RssSnapshot::find(const std::string& link, size_t lastChecked, RssChannel& out) const
+{
+    auto found = byLink.find(link);
+    if(found == byLink.end()) return false;
+
+    const ChannelRecord& rec = channelRecs[found->second];
+    if(rec.lastChecked != lastChecked) return false; //The record is newer or older than this snapshot
+
+    out.title = str(rec.title);
+    out.description = str(rec.description);
+    out.link = str(rec.link);
+    out.etag = str(rec.etag);
+    out.lastModified = str(rec.lastModified);
+    out.ttl = rec.ttl;
+    out.skipHours = rec.skipHours;
+    out.skipDays = rec.skipDays;
+    out.lastChecked = rec.lastChecked;
+    out.arena = std::make_shared<RssArena>();
+    out.arena->keepAlive(file); //Item text points straight into the mapped file
+    out.image = image(rec.image);
+
+    out.items.resize(rec.itemCount); 
+    for(size_t i = 0; i < rec.itemCount; ++i)
+    {
+        const ItemRecord& itemRec = itemRecs[rec.firstItem + i];
+        RssItem& item = out.items[i];
+        item.title = view(itemRec.title);
+        item.description = view(itemRec.description);
+        item.link = view(itemRec.link);
+        item.pubDate = view(itemRec.pubDate);
+        item.author = view(itemRec.author);
+        item.guid = view(itemRec.guid);
+        item.enclosure = image(itemRec.enclosure);
+        item.contentHash = itemRec.contentHash;
+        item.published = itemRec.published; //The date was read when the item was first parsed
+    }
+    out.sortByDate();
+    return true;
+}
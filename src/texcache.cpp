@@ -0,0 +1,238 @@
+#include "include/texcache.hpp"
+
+#include <algorithm>
+#include <vector>
+
+//Dear ImGui compiles its copy of the packer as static functions, so this file needs its own
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imstb_rectpack.h"
+
+/**
+ * @brief A texture that many small images are packed into. The packer can't take back the space
+ * of a released image, so a page is deleted and its space reused only when it is empty or evicted
+ *
+ */
+struct RssTextureCache::AtlasPage
+{
+    GLuint txID;  //OpenGL texture ID of the page
+    stbrp_context packer;           //Where the next images can go
+    std::vector<stbrp_node> nodes;  //Memory for the packer, one node per pixel of width
+    std::vector<std::string> urls;  //The URLs of the images in the page that weren't released
+};
+
+/**
+ * @brief Function to clear a texture to transparent on the GPU, so a new atlas page doesn't need
+ * a buffer of empty pixels uploaded to it
+ *
+ * @param txID The OpenGL texture ID
+ */
+static void clearTexture(GLuint txID)
+{
+    if(GLAD_GL_ARB_clear_texture) //Most drivers can clear a texture directly
+    {
+        glClearTexImage(txID, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        return;
+    }
+
+    //Otherwise attach the texture to a framebuffer and clear that, putting back the state that Dear ImGui draws with
+    GLint lastFramebuffer;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &lastFramebuffer);
+    GLfloat lastClearColor[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, lastClearColor);
+    GLboolean lastScissorTest = glIsEnabled(GL_SCISSOR_TEST);
+
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, txID, 0);
+    glDisable(GL_SCISSOR_TEST); //The scissor rectangle would limit the clear
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)lastFramebuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    glClearColor(lastClearColor[0], lastClearColor[1], lastClearColor[2], lastClearColor[3]);
+    if(lastScissorTest) glEnable(GL_SCISSOR_TEST);
+}
+
+RssTextureCache::RssTextureCache(void) {}
+RssTextureCache::~RssTextureCache() {}
+
+RssTexture RssTextureCache::upload(const RssImageData& img)
+{
+    RssTexture tex;
+    tex.width = img.width;
+    tex.height = img.height;
+
+    glGenTextures(1, &tex.txID); //Generate a texture ID in openGL
+    glBindTexture(GL_TEXTURE_2D, tex.txID);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // This is required on WebGL for non power-of-two textures
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); // Same
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img.width, img.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, img.pixels.data()); //Generate an OpenGL texture using the image data
+    return tex;
+}
+
+const RssTexture* RssTextureCache::draw(const std::string& url)
+{
+    auto found = textures.find(url);
+    if(found == textures.end()) return NULL;
+
+    found->second.lastDrawn = frame;
+    return &found->second.texture;
+}
+
+void RssTextureCache::insert(const std::string& url, const RssImageData& img)
+{
+    if(textures.count(url) != 0) return; //Don't upload the same image twice
+
+    Entry entry;
+    entry.page = NULL;
+    entry.bytes = 0;
+    if(img.width <= std::min(atlasMaxWidth, ATLAS_PAGE_SIZE / 2) && img.height <= ATLAS_PAGE_SIZE / 2) insertIntoAtlas(url, img, entry); //Thumbnails share a texture so they draw together
+    else
+    {
+        entry.texture = upload(img);
+        entry.bytes = (size_t)img.width * img.height * 4; //RGBA with no mipmaps
+    }
+    entry.lastDrawn = frame; //It was requested because it is on screen, so don't evict it before it is drawn
+    textures.emplace(url, entry);
+    totalBytes += entry.bytes;
+
+    evict();
+}
+
+void RssTextureCache::insertIntoAtlas(const std::string& url, const RssImageData& img, Entry& entry)
+{
+    stbrp_rect rect = {}; //Leave a row and column empty after the image so linear filtering doesn't blend neighbouring images
+    rect.w = img.width + 1;
+    rect.h = img.height + 1;
+
+    AtlasPage* page = NULL;
+    for(auto& candidate : pages) //Use the first page with room for the image
+    {
+        stbrp_pack_rects(&candidate->packer, &rect, 1);
+        if(rect.was_packed)
+        {
+            page = candidate.get();
+            break;
+        }
+    }
+
+    if(page == NULL) //Every page is full, so start a new one
+    {
+        pages.emplace_back(new AtlasPage);
+        page = pages.back().get();
+        page->nodes.resize(ATLAS_PAGE_SIZE);
+        stbrp_init_target(&page->packer, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE, page->nodes.data(), (int)page->nodes.size());
+        stbrp_pack_rects(&page->packer, &rect, 1); //Always fits in an empty page
+
+        glGenTextures(1, &page->txID);
+        glBindTexture(GL_TEXTURE_2D, page->txID);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL); //Only allocate the page
+        clearTexture(page->txID); //Clear the page so the gaps between images are transparent
+        totalBytes += ATLAS_PAGE_BYTES; //The whole page counts against the budget, used or not
+        logI("Added image atlas page %zu", pages.size());
+    }
+
+    glBindTexture(GL_TEXTURE_2D, page->txID);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, (int)rect.x, (int)rect.y, img.width, img.height, GL_RGBA, GL_UNSIGNED_BYTE, img.pixels.data()); //Copy the image into its spot in the page
+    page->urls.push_back(url);
+
+    float texel = 1.f / ATLAS_PAGE_SIZE; //The size of one pixel of the page in texture coordinates
+    entry.page = page;
+    entry.texture.txID = page->txID;
+    entry.texture.width = img.width;
+    entry.texture.height = img.height;
+    entry.texture.u0 = rect.x * texel;
+    entry.texture.v0 = rect.y * texel;
+    entry.texture.u1 = (rect.x + img.width) * texel;
+    entry.texture.v1 = (rect.y + img.height) * texel;
+}
+
+void RssTextureCache::release(const std::string& url)
+{
+    auto found = textures.find(url);
+    if(found == textures.end()) return;
+
+    AtlasPage* page = found->second.page;
+    if(page == NULL) glDeleteTextures(1, &found->second.texture.txID);
+    else
+    {
+        page->urls.erase(std::find(page->urls.begin(), page->urls.end(), url));
+        if(page->urls.empty()) //Delete the page once nothing is drawn from it
+        {
+            glDeleteTextures(1, &page->txID);
+            totalBytes -= ATLAS_PAGE_BYTES;
+            pages.erase(std::find_if(pages.begin(), pages.end(), [page](const auto& p) { return p.get() == page; }));
+        }
+    }
+    totalBytes -= found->second.bytes;
+    textures.erase(found);
+}
+
+void RssTextureCache::clear(void)
+{
+    for(auto& tex : textures)
+    {
+        if(tex.second.page == NULL) glDeleteTextures(1, &tex.second.texture.txID);
+    }
+    for(auto& page : pages) glDeleteTextures(1, &page->txID);
+    textures.clear();
+    pages.clear();
+    totalBytes = 0;
+}
+
+void RssTextureCache::nextFrame(void)
+{
+    ++frame;
+    evict(); //The budget can shrink between frames
+}
+
+void RssTextureCache::evict(void)
+{
+    if(totalBytes <= budgetBytes) return;
+
+    //Every image texture and atlas page that wasn't drawn in the last frame, with when it was drawn.
+    //A page was drawn when any of its images was, and only the URLs of images with their own texture are listed
+    struct Candidate
+    {
+        uint64_t lastDrawn;
+        std::string url;
+        AtlasPage* page;
+    };
+    std::vector<Candidate> oldest;
+    for(const auto& tex : textures)
+    {
+        if(tex.second.page == NULL && tex.second.lastDrawn + 1 < frame) oldest.push_back(Candidate{tex.second.lastDrawn, tex.first, NULL});
+    }
+    for(const auto& page : pages)
+    {
+        uint64_t newest = 0;
+        for(const std::string& url : page->urls) newest = std::max(newest, textures.at(url).lastDrawn);
+        if(newest + 1 < frame) oldest.push_back(Candidate{newest, std::string(), page.get()});
+    }
+    std::sort(oldest.begin(), oldest.end(), [](const Candidate& a, const Candidate& b) { return a.lastDrawn < b.lastDrawn; });
+
+    size_t evicted = 0;
+    for(const Candidate& candidate : oldest)
+    {
+        if(totalBytes <= budgetBytes) break;
+        if(candidate.page == NULL) release(candidate.url);
+        else
+        {
+            std::vector<std::string> urls = candidate.page->urls; //Releasing the last image deletes the page and its list
+            for(const std::string& url : urls) release(url);
+        }
+        ++evicted;
+    }
+    if(evicted > 0) logI("Evicted %zu image textures and atlas pages, %zu bytes of textures left", evicted, totalBytes);
+}
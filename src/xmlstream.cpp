@@ -0,0 +1,414 @@
+#include "include/xmlstream.hpp"
+
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+
+size_t encodeUTF8(unsigned long codePoint, char* out)
+{
+    if(codePoint < 0x80)
+    {
+        out[0] = (char)codePoint;
+        return 1;
+    }
+    if(codePoint < 0x800)
+    {
+        out[0] = (char)(0xC0 | (codePoint >> 6));
+        out[1] = (char)(0x80 | (codePoint & 0x3F));
+        return 2;
+    }
+    if(codePoint < 0x10000)
+    {
+        out[0] = (char)(0xE0 | (codePoint >> 12));
+        out[1] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (codePoint & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (codePoint >> 18));
+    out[1] = (char)(0x80 | ((codePoint >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (codePoint & 0x3F));
+    return 4;
+}
+
+/**
+ * @brief Function to check if a character is XML whitespace
+ *
+ * @param c The character
+ * @return true if it is a space, tab, or line ending
+ */
+static inline bool isXmlSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/**
+ * @brief Function to find a string in a buffer
+ *
+ * @param data The buffer
+ * @param size The size of the buffer
+ * @param from Where to start looking
+ * @param str The string to find
+ * @return size_t The position of the string, or std::string::npos
+ */
+static size_t findIn(const char* data, size_t size, size_t from, const char* str)
+{
+    return std::string_view(data, size).find(str, from);
+}
+
+RssXmlStream::RssXmlStream(RssXmlHandler& t_handler) : handler(t_handler)
+{
+
+}
+
+bool RssXmlStream::feed(const char* data, size_t size)
+{
+    if(failed) return false;
+
+    if(buffer.empty()) //Parse the piece where it is, only copying what is left over
+    {
+        resumeAt = 0;
+        size_t used = parse(data, size);
+        if(!failed) buffer.assign(data + used, size - used);
+    }
+    else
+    {
+        buffer.append(data, size);
+        size_t used = parse(buffer.data(), buffer.size());
+        if(!failed) buffer.erase(0, used);
+    }
+    return !failed;
+}
+
+bool RssXmlStream::finish(void)
+{
+    if(failed) return false;
+
+    for(char c : buffer) //Only whitespace may be left over after the root element
+    {
+        if(!isXmlSpace(c))
+        {
+            fail("Unexpected end of document");
+            return false;
+        }
+    }
+    if(!sawRoot) fail("No root element");
+    else if(!openStarts.empty()) fail("Unexpected end of document, element <" + openNames.substr(openStarts.back()) + "> is not closed");
+    return !failed;
+}
+
+void RssXmlStream::fail(const std::string& message)
+{
+    if(failed) return;
+    failed = true;
+    errorMessage = message;
+}
+
+size_t RssXmlStream::parse(const char* data, size_t size)
+{
+    size_t pos = 0;
+    size_t resume = resumeAt; //How much of the unfinished node at the start of the buffer was already searched
+    resumeAt = 0;
+
+    //Stop at an unfinished node, remembering how much of it was searched so the next piece doesn't search it again.
+    //lookback is the length of the node's terminator minus one, which may have started at the end of this piece
+    auto unfinished = [&](size_t lookback) -> size_t
+    {
+        resumeAt = (size - pos > lookback) ? size - pos - lookback : 0;
+        return pos;
+    };
+    if(!started)
+    {
+        if(size < 3) return 0; //Wait for enough bytes to see a byte order mark
+        started = true;
+        if(memcmp(data, "\xEF\xBB\xBF", 3) == 0) pos = 3; //Skip the UTF-8 byte order mark
+        else if( (data[0] == '\xFF' && data[1] == '\xFE') || (data[0] == '\xFE' && data[1] == '\xFF') )
+        {
+            fail("Unsupported encoding UTF-16");
+            return 0;
+        }
+    }
+
+    while(pos < size && !failed)
+    {
+        const char* p = data + pos;
+        size_t remaining = size - pos;
+        size_t searched = (pos == 0) ? resume : 0; //Only the first node can be one that was searched before
+
+        if(*p != '<') //Text up to the next tag
+        {
+            size_t skip = std::min(searched, remaining);
+            const char* next = (const char*)memchr(p + skip, '<', remaining - skip);
+            if(next == NULL) return unfinished(0); //The text may go on in the next piece
+            if(!openStarts.empty()) emitText(p, next - p, false); //Text outside of the root element is ignored
+            pos = next - data;
+            continue;
+        }
+
+        if(remaining < 2) return pos;
+        if(p[1] == '!')
+        {
+            if(remaining < 4) return pos;
+            if(memcmp(p, "<!--", 4) == 0) //Comment
+            {
+                size_t end = findIn(data, size, std::max<size_t>(pos + 4, searched), "-->");
+                if(end == std::string::npos) return unfinished(2);
+                pos = end + 3;
+                continue;
+            }
+
+            if(remaining < 9) return pos;
+            if(memcmp(p, "<![CDATA[", 9) == 0)
+            {
+                size_t end = findIn(data, size, std::max<size_t>(pos + 9, searched), "]]>");
+                if(end == std::string::npos) return unfinished(2);
+                if(!openStarts.empty()) emitText(p + 9, end - (pos + 9), true);
+                pos = end + 3;
+                continue;
+            }
+
+            //A DOCTYPE or other declaration, which may have an internal subset in brackets
+            size_t bracketDepth = 0;
+            size_t end = pos + 2;
+            for(; end < size; ++end)
+            {
+                if(data[end] == '[') bracketDepth++;
+                else if(data[end] == ']' && bracketDepth > 0) bracketDepth--;
+                else if(data[end] == '>' && bracketDepth == 0) break;
+            }
+            if(end >= size) return pos;
+            pos = end + 1;
+        }
+        else if(p[1] == '?') //Processing instruction or the XML declaration
+        {
+            size_t end = findIn(data, size, std::max<size_t>(pos + 2, searched), "?>");
+            if(end == std::string::npos) return unfinished(1);
+            if(end - pos >= 5 && memcmp(p + 2, "xml", 3) == 0 && isXmlSpace(p[5])) checkDeclaration(p + 2, end - pos - 2);
+            pos = end + 2;
+        }
+        else if(p[1] == '/') //End tag
+        {
+            size_t skip = std::min(searched, remaining);
+            const char* end = (const char*)memchr(p + skip, '>', remaining - skip);
+            if(end == NULL) return unfinished(0);
+
+            const char* nameEnd = end;
+            while(nameEnd > p + 2 && isXmlSpace(nameEnd[-1])) --nameEnd;
+            std::string_view name(p + 2, nameEnd - (p + 2));
+            if(openStarts.empty() || name != std::string_view(openNames).substr(openStarts.back()))
+            {
+                fail("Mismatched end tag </" + std::string(name) + ">");
+                return pos;
+            }
+
+            handler.endElement(name);
+            openNames.resize(openStarts.back());
+            openStarts.pop_back();
+            pos = end + 1 - data;
+        }
+        else //Start tag, which can have a '>' inside of a quoted attribute value
+        {
+            size_t end = pos + 1;
+            char quote = 0;
+            for(; end < size; ++end)
+            {
+                char c = data[end];
+                if(quote != 0)
+                {
+                    if(c == quote) quote = 0;
+                }
+                else if(c == '"' || c == '\'') quote = c;
+                else if(c == '>') break;
+            }
+            if(end >= size) return pos;
+
+            parseStartTag(p + 1, end - pos - 1);
+            pos = end + 1;
+        }
+    }
+    return pos;
+}
+
+void RssXmlStream::parseStartTag(const char* tag, size_t size)
+{
+    bool empty = size > 0 && tag[size - 1] == '/'; //An empty element tag like <enclosure ... />
+    if(empty) --size;
+
+    size_t pos = 0;
+    while(pos < size && !isXmlSpace(tag[pos])) ++pos;
+    std::string_view name(tag, pos);
+    if(name.empty())
+    {
+        fail("Start tag with no name");
+        return;
+    }
+
+    //Find the raw attribute values first so that decoding never moves the decoded values
+    attributes.clear();
+    size_t rawBytes = 0;
+    while(true)
+    {
+        while(pos < size && isXmlSpace(tag[pos])) ++pos;
+        if(pos >= size) break;
+
+        size_t nameStart = pos;
+        while(pos < size && tag[pos] != '=' && !isXmlSpace(tag[pos])) ++pos;
+        std::string_view attrName(tag + nameStart, pos - nameStart);
+
+        while(pos < size && isXmlSpace(tag[pos])) ++pos;
+        if(pos >= size || tag[pos] != '=')
+        {
+            fail("Attribute " + std::string(attrName) + " of <" + std::string(name) + "> has no value");
+            return;
+        }
+        ++pos;
+        while(pos < size && isXmlSpace(tag[pos])) ++pos;
+        if(pos >= size || (tag[pos] != '"' && tag[pos] != '\''))
+        {
+            fail("Attribute " + std::string(attrName) + " of <" + std::string(name) + "> is not quoted");
+            return;
+        }
+
+        const char* valueEnd = (const char*)memchr(tag + pos + 1, tag[pos], size - pos - 1);
+        if(valueEnd == NULL)
+        {
+            fail("Attribute " + std::string(attrName) + " of <" + std::string(name) + "> is not closed");
+            return;
+        }
+        attributes.push_back(RssXmlAttribute{attrName, std::string_view(tag + pos + 1, valueEnd - (tag + pos + 1))});
+        rawBytes += attributes.back().value.size();
+        pos = valueEnd + 1 - tag;
+    }
+
+    attributeValues.clear();
+    attributeValues.reserve(rawBytes); //Decoded values are never longer than the raw values
+    for(RssXmlAttribute& attr : attributes)
+    {
+        size_t start = attributeValues.size();
+        decode(attr.value.data(), attr.value.size(), attributeValues, true);
+        attr.value = std::string_view(attributeValues.data() + start, attributeValues.size() - start);
+    }
+
+    sawRoot = true;
+    handler.startElement(name, attributes.data(), attributes.size());
+    if(empty)
+    {
+        handler.endElement(name);
+    }
+    else
+    {
+        openStarts.push_back(openNames.size());
+        openNames.append(name);
+    }
+}
+
+void RssXmlStream::checkDeclaration(const char* decl, size_t size)
+{
+    std::string_view declaration(decl, size);
+    size_t pos = declaration.find("encoding");
+    if(pos == std::string_view::npos) return; //UTF-8 is the default
+
+    size_t quote = declaration.find_first_of("\"'", pos);
+    if(quote == std::string_view::npos) return;
+    size_t end = declaration.find(declaration[quote], quote + 1);
+    if(end == std::string_view::npos) return;
+
+    std::string encoding(declaration.substr(quote + 1, end - quote - 1));
+    for(char& c : encoding) c = (char)std::tolower((unsigned char)c);
+    if(encoding != "utf-8" && encoding != "utf8" && encoding != "us-ascii" && encoding != "ascii")
+    {
+        fail("Unsupported encoding " + encoding);
+    }
+}
+
+void RssXmlStream::emitText(const char* str, size_t size, bool cdata)
+{
+    if(!cdata)
+    {
+        size_t i = 0;
+        while(i < size && isXmlSpace(str[i])) ++i;
+        if(i == size) return; //Skip whitespace between tags
+    }
+
+    if(memchr(str, '\r', size) == NULL && (cdata || memchr(str, '&', size) == NULL)) //Nothing to decode, so pass the text where it is
+    {
+        handler.text(std::string_view(str, size));
+        return;
+    }
+
+    decoded.clear();
+    if(cdata) //Only line endings are changed in CDATA
+    {
+        for(size_t i = 0; i < size; ++i)
+        {
+            if(str[i] != '\r') decoded.push_back(str[i]);
+            else
+            {
+                decoded.push_back('\n');
+                if(i + 1 < size && str[i + 1] == '\n') ++i;
+            }
+        }
+    }
+    else decode(str, size, decoded, false);
+    handler.text(decoded);
+}
+
+void RssXmlStream::decode(const char* str, size_t size, std::string& out, bool attribute)
+{
+    for(size_t i = 0; i < size; ++i)
+    {
+        char c = str[i];
+        if(c == '\r') //Line endings become '\n'
+        {
+            if(i + 1 < size && str[i + 1] == '\n') ++i;
+            out.push_back(attribute ? ' ' : '\n');
+            continue;
+        }
+        if(attribute && (c == '\n' || c == '\t'))
+        {
+            out.push_back(' ');
+            continue;
+        }
+        if(c != '&')
+        {
+            out.push_back(c);
+            continue;
+        }
+
+        const char* semi = (const char*)memchr(str + i + 1, ';', std::min<size_t>(size - i - 1, 10)); //Entities are short
+        if(semi == NULL)
+        {
+            out.push_back(c);
+            continue;
+        }
+
+        std::string_view name(str + i + 1, semi - (str + i + 1));
+        char single = 0;
+        if(name == "amp") single = '&';
+        else if(name == "lt") single = '<';
+        else if(name == "gt") single = '>';
+        else if(name == "quot") single = '"';
+        else if(name == "apos") single = '\'';
+        else if(name.size() > 1 && name[0] == '#')
+        {
+            char* end;
+            unsigned long codePoint = (name[1] == 'x' || name[1] == 'X') ? strtoul(name.data() + 2, &end, 16) : strtoul(name.data() + 1, &end, 10);
+            if(end == semi && codePoint > 0 && codePoint <= 0x10FFFF)
+            {
+                char utf8[4];
+                out.append(utf8, encodeUTF8(codePoint, utf8));
+                i = semi - str;
+                continue;
+            }
+        }
+
+        if(single == 0) //Not an entity that XML defines, so keep it as it is
+        {
+            out.push_back(c);
+            continue;
+        }
+        out.push_back(single);
+        i = semi - str;
+    }
+}